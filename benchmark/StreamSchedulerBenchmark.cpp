@@ -0,0 +1,114 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+// Scaling of the StreamScheduler from one worker thread to one per hardware
+// thread: a fixed set of 5.1 streams is fed as fast as their queues take
+// blocks, and the blocks decoded per second and the deadline misses (blocks
+// finished more than one blocksize after their submission) are printed for
+// each number of threads.
+//
+// usage: StreamSchedulerBenchmark [streams] [blocks per stream] [blocksize] [pin (0/1)]
+
+#include "../include/FreeSurround/StreamScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+int main(const int argc, char **argv)
+{
+    const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+    const unsigned int streams = argc > 1 ? std::atoi(argv[1]) : 4 * cores;
+    const unsigned int blocks = argc > 2 ? std::atoi(argv[2]) : 200;
+    const unsigned int blocksize = argc > 3 ? std::atoi(argv[3]) : 4096;
+    const bool pin = argc > 4 && std::atoi(argv[4]) != 0;
+    if (streams == 0 || blocks == 0 || blocksize < 2 || blocksize % 2 != 0)
+    {
+        std::fprintf(stderr, "usage: %s [streams] [blocks per stream] [blocksize] [pin (0/1)]\n", argv[0]);
+        return 1;
+    }
+
+    // a few blocks of noise that every stream cycles through
+    constexpr unsigned int distinct = 8;
+    std::mt19937 rng(1);
+    std::normal_distribution<float> noise(0, 0.1f);
+    std::vector<float> input(2 * static_cast<std::size_t>(blocksize) * distinct);
+    for (float &v : input)
+        v = noise(rng);
+
+    std::printf("%u streams x %u blocks of %u frames (5.1, 48 kHz)%s\n", streams, blocks, blocksize,
+                pin ? ", pinned" : "");
+    std::printf("threads    blocks/s    speedup    deadline misses\n");
+    double single = 0;
+    for (unsigned int threads = 1; threads <= cores; threads++)
+    {
+        StreamScheduler scheduler(streams, 4, threads, pin);
+        for (unsigned int s = 0; s < streams; s++)
+        {
+            DPL2FSDecoder decoder;
+            decoder.Init(channel_setup::cs_5point1, blocksize, 48000);
+            scheduler.add_stream(std::move(decoder), [](unsigned int, const float *) {});
+        }
+
+        // round-robin over the streams, each taking as many blocks as its
+        // queue has room for
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<unsigned int> submitted(streams, 0);
+        for (unsigned int done = 0; done < streams;)
+        {
+            done = 0;
+            bool progress = false;
+            for (unsigned int s = 0; s < streams; s++)
+            {
+                while (submitted[s] < blocks &&
+                       scheduler.submit(s, &input[2 * static_cast<std::size_t>(blocksize) *
+                                                 ((s + submitted[s]) % distinct)]))
+                {
+                    submitted[s]++;
+                    progress = true;
+                }
+                done += submitted[s] == blocks;
+            }
+            if (!progress)
+                std::this_thread::yield();
+        }
+        unsigned long long decoded = 0;
+        unsigned long long misses = 0;
+        for (const unsigned long long total = static_cast<unsigned long long>(streams) * blocks; decoded < total;)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            decoded = 0;
+            misses = 0;
+            for (unsigned int s = 0; s < streams; s++)
+            {
+                const stream_statistics stats = scheduler.statistics(s);
+                decoded += stats.decoded;
+                misses += stats.deadline_misses;
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double rate = static_cast<double>(decoded) / seconds;
+        if (threads == 1)
+            single = rate;
+        std::printf("%7u %11.0f %9.2fx %18llu\n", threads, rate, rate / single, misses);
+    }
+    return 0;
+}
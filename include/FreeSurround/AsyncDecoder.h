@@ -0,0 +1,125 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "FreeSurroundDecoder.h"
+
+// Counters of an AsyncDecoder.
+struct async_statistics
+{
+    // blocks decoded by the worker
+    unsigned long long decoded;
+    // blocks that pop() found missing (and replaced by silence)
+    unsigned long long underflows;
+    // blocks that push() refused because the input queue was full
+    unsigned long long overflows;
+};
+
+// Runs a decoder on a worker thread of its own, so that the thread that feeds
+// it (typically an audio callback) never waits for a block to be decoded.
+// Input and output blocks pass through two lock-free single-producer
+// single-consumer rings; push() and pop() neither lock nor allocate, and may
+// be called from one thread (or one each) at a time. The output lags the
+// input by prefetch blocks, which is the time the worker has for each block:
+// the first prefetch pops give silence, and after that a block that is not
+// decoded in time is reported as an underflow and replaced by silence. A
+// late block is dropped when it arrives, so that the lag stays the same.
+class AsyncDecoder
+{
+public:
+    // Take over an initialized decoder, with its parameters set, and start
+    // the worker. The prefetch is at least one block, as the worker needs
+    // time to decode. With a decoder that is not initialized, push() and
+    // pop() always fail.
+    explicit AsyncDecoder(DPL2FSDecoder &&decoder, unsigned int prefetch = 1);
+    ~AsyncDecoder();
+    AsyncDecoder(const AsyncDecoder &) = delete;
+    AsyncDecoder &operator=(const AsyncDecoder &) = delete;
+
+    // Queue a block of blocksize stereo frames; returns false (and counts an
+    // overflow) if prefetch+1 blocks are already waiting. The output of a
+    // refused block is missing prefetch pops later.
+    bool push(const float *input);
+
+    // Take the next block of blocksize multichannel frames (as float, in the
+    // decoder's channel order); returns false if it was not ready, in which
+    // case output receives silence.
+    bool pop(float *output);
+
+    // push(input), then pop(output), as an audio callback would
+    bool process(const float *input, float *output);
+
+    // the counters (may be read from any thread)
+    [[nodiscard]] async_statistics statistics() const;
+
+    // the decoder's output layout
+    [[nodiscard]] spectral_layout layout() const;
+
+private:
+    // A ring of blocks of a fixed size, written by one thread and read by
+    // another. pushed and popped only ever grow; their difference is the
+    // number of blocks in the ring. Each block is tagged with the number of
+    // the push() call that brought it in.
+    struct ring
+    {
+        void init(unsigned int capacity, std::size_t block);
+        [[nodiscard]] bool empty() const;
+        [[nodiscard]] bool full() const;
+        // the block to write next and the one to read next, and their tags
+        float *back();
+        float *front();
+        unsigned long long &back_tag();
+        unsigned long long &front_tag();
+
+        std::vector<float> data;
+        std::vector<unsigned long long> tags;
+        std::size_t block = 0;
+        unsigned int capacity = 0;
+        std::atomic<unsigned long long> pushed = 0;
+        std::atomic<unsigned long long> popped = 0;
+    };
+
+    // the worker's loop
+    void run();
+
+    // wake the worker after a change to either ring (the thread that pops
+    // never waits)
+    void signal();
+
+    DPL2FSDecoder decoder;
+    spectral_layout shape = {};
+    unsigned int frames;
+    ring input;
+    ring output;
+
+    unsigned int prefetch;
+    // the number of push() and of pop() calls so far (each used only by the
+    // thread that makes them)
+    unsigned long long pushes = 0;
+    unsigned long long pops = 0;
+
+    std::atomic<unsigned long long> decoded = 0;
+    std::atomic<unsigned long long> underflows = 0;
+    std::atomic<unsigned long long> overflows = 0;
+
+    // bumped on every change the worker may wait for
+    std::atomic<unsigned int> epoch = 0;
+    std::atomic<bool> stopping = false;
+    std::thread worker;
+};
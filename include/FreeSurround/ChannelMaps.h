@@ -30,3 +30,5 @@ extern const std::map<unsigned, std::vector<float>> chn_angle;
 extern const std::map<unsigned, std::vector<float>> chn_xsf;
 extern const std::map<unsigned, std::vector<float>> chn_ysf;
 extern const std::map<unsigned, std::vector<channel_id>> chn_id;
+// speaker orderings (per channel_order)
+extern const std::map<unsigned, std::vector<channel_id>> chn_order;
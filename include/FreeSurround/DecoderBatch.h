@@ -0,0 +1,83 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "FreeSurroundDecoder.h"
+
+// number of streams whose bins DecoderBatch steers in lock-step: one per
+// lane of the widest SIMD registers (of doubles) the build targets
+#if defined(__AVX512F__)
+constexpr unsigned int batch_width = 8;
+#elif defined(__AVX__)
+constexpr unsigned int batch_width = 4;
+#else
+constexpr unsigned int batch_width = 2;
+#endif
+
+// Decodes many independent stereo streams of the same configuration in
+// lock-step. Each stream has a DPL2FSDecoder of its own, which holds its
+// buffers and parameters and does the transforms and the synthesis. What
+// changes is the steering of the bins: it is done for batch_width streams at
+// a time, one per SIMD lane, with the per-bin values laid out as arrays over
+// the lanes and the math written so that compilers vectorize it (no pow(),
+// and one atan2() per bin instead of three atan2() plus a cos() and sin() per
+// channel). The output thus matches that of the streams' own decode() only up
+// to rounding: these approximations may differ from libm in the last bits of
+// a double, which can change the last bit of an output sample, so batched
+// and independent decoding are not guaranteed to agree bit for bit. Blocks
+// that take another path (silent, transient, fully correlated or steered by
+// bands) are decoded as they would be on their own.
+class DecoderBatch
+{
+public:
+    // Set up the given number of streams, all initialized like
+    // DPL2FSDecoder::Init() with the given configuration.
+    void Init(unsigned int streams, channel_setup chsetup = channel_setup::cs_5point1, unsigned int blocksize = 4096,
+              unsigned int sample_rate = 48000);
+
+    // number of streams
+    [[nodiscard]] unsigned int size() const;
+
+    // The decoder of stream s, to set its parameters and output format. A
+    // stream that is reconfigured, or whose overlap differs from that of the
+    // others, is decoded on its own.
+    DPL2FSDecoder &stream(unsigned int s);
+
+    // Decode a chunk of blocksize stereo frames of each stream into its output
+    // (of blocksize frames in the stream's output format), as
+    // DPL2FSDecoder::decode(input, output) does.
+    void decode(const float *const *inputs, void *const *outputs);
+    void decode(const std::int16_t *const *inputs, void *const *outputs);
+    void decode(const pcm24 *const *inputs, void *const *outputs);
+    void decode(const std::int32_t *const *inputs, void *const *outputs);
+
+private:
+    template <typename Sample>
+    void decode_pcm(const Sample *const *inputs, void *const *outputs);
+
+    // steer the bins in the processing range of up to batch_width streams
+    void steer_lanes(const unsigned int *lanes, unsigned int count);
+
+    decoder_config config = {};
+    std::vector<DPL2FSDecoder> streams;
+
+    // the streams that are decoded in lock-step, and those of them whose
+    // current block is steered by steer_lanes()
+    std::vector<unsigned int> lockstep;
+    std::vector<unsigned int> steered;
+};
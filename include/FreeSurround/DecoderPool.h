@@ -0,0 +1,54 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "FreeSurroundDecoder.h"
+
+// A pool of initialized decoders, kept by configuration, so that starting a
+// new stream does not pay for Init() and the allocation of its buffers and
+// FFT setups. Decoders are handed out and taken back by value (moving them
+// does not allocate). The pool may be used from several threads at once.
+class DecoderPool
+{
+public:
+    // initialize count more idle decoders for the given configuration
+    void prepare(const decoder_config &config, unsigned int count);
+
+    // take an idle decoder for the given configuration, or initialize a new
+    // one if there is none
+    DPL2FSDecoder acquire(const decoder_config &config);
+
+    // hand a decoder back for reuse under its current configuration (see
+    // DPL2FSDecoder::config()); its parameters are set back to their defaults
+    // (see DPL2FSDecoder::reset_parameters()), and it is flushed and its
+    // statistics are reset, so that its next user gets it as Init() left it.
+    // Decoders that are not initialized are dropped.
+    void release(DPL2FSDecoder &&decoder);
+
+    // number of idle decoders for the given configuration
+    [[nodiscard]] std::size_t idle(const decoder_config &config) const;
+
+    // drop all idle decoders
+    void clear();
+
+private:
+    mutable std::mutex lock;
+    std::map<decoder_config, std::vector<DPL2FSDecoder>> decoders;
+};
@@ -0,0 +1,91 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#define FREESURROUND_FTZ_SSE
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define FREESURROUND_FTZ_ARM64
+#endif
+
+// Puts the floating-point unit of the calling thread into flush-to-zero /
+// denormals-are-zero mode for the lifetime of the object and restores the
+// previous mode when it goes out of scope. Decaying signals otherwise produce
+// denormal numbers, which are up to two orders of magnitude slower to process
+// on most CPUs. Scopes may be nested.
+class DenormalScope
+{
+public:
+#if defined(FREESURROUND_FTZ_SSE)
+    static constexpr bool supported = true;
+
+    DenormalScope() : saved(_mm_getcsr())
+    {
+        // FTZ (bit 15) and DAZ (bit 6)
+        if ((saved & 0x8040) != 0x8040)
+            _mm_setcsr(saved | 0x8040);
+    }
+
+    ~DenormalScope()
+    {
+        if ((saved & 0x8040) != 0x8040)
+            _mm_setcsr(saved);
+    }
+#elif defined(FREESURROUND_FTZ_ARM64)
+    static constexpr bool supported = true;
+
+    DenormalScope()
+    {
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(saved));
+        // FZ (bit 24); AArch64 flushes denormal inputs as well in this mode
+        if (!(saved & 1 << 24))
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(saved | 1 << 24));
+    }
+
+    ~DenormalScope()
+    {
+        if (!(saved & 1 << 24))
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(saved));
+    }
+#else
+    // no way to switch the mode here; callers flush by other means
+    static constexpr bool supported = false;
+#endif
+
+    DenormalScope(const DenormalScope &) = delete;
+    DenormalScope &operator=(const DenormalScope &) = delete;
+
+private:
+#if defined(FREESURROUND_FTZ_SSE)
+    unsigned int saved;
+#elif defined(FREESURROUND_FTZ_ARM64)
+    std::uint64_t saved;
+#endif
+};
+
+// Flushes a float that is too small to matter to zero without a branch, for
+// platforms where DenormalScope is not supported: adding and subtracting the
+// offset rounds away everything below its precision (ca. 1e-37).
+inline float flush_denormal(const float x)
+{
+    constexpr float offset = 1e-30f;
+    if constexpr (DenormalScope::supported)
+        return x;
+    else
+        return x + offset - offset;
+}
@@ -16,9 +16,17 @@
 // USA.
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <compare>
 #include <complex>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 #include "KissFFTR.h"
+#include "SlidingDFT.h"
 
 using cplx = std::complex<double>;
 
@@ -67,6 +75,101 @@ constexpr unsigned int to_uint(const channel_setup setup) {
     return std::to_underlying(setup);
 }
 
+constexpr unsigned int to_uint(const channel_id id) {
+    return std::to_underlying(id);
+}
+
+// A packed, little-endian 24-bit PCM sample (as found in 24-bit WAVE data).
+struct pcm24
+{
+    std::uint8_t bytes[3];
+};
+
+// Sample formats that decoded output can be written in.
+enum class sample_format {
+    sf_float, // 32-bit float, nominally in [-1,1]
+    sf_int16, // 16-bit PCM
+    sf_int24  // packed 24-bit PCM (see pcm24)
+};
+
+// Orderings of the interleaved output channels.
+enum class channel_order {
+    co_native, // the decoder's own order (front to back, left to right, LFE last)
+    co_wave,   // WAVE_FORMAT_EXTENSIBLE speaker mask order (FL, FR, FC, LFE, BL, BR, ..., SL, SR)
+    co_smpte   // SMPTE/ITU order (L, R, C, LFE, Ls, Rs, Lrs, Rrs)
+};
+
+// The configuration of a decoder, as given to DPL2FSDecoder::Init() or
+// reconfigure(); the blocksize is 0 for a decoder that is not initialized.
+struct decoder_config
+{
+    channel_setup setup;
+    unsigned int blocksize;
+    unsigned int sample_rate;
+
+    auto operator<=>(const decoder_config &) const = default;
+};
+
+// Layout of the per-channel spectra produced by DPL2FSDecoder::analyze().
+struct spectral_layout
+{
+    // transform size (the blocksize) and the number of frames between two
+    // consecutive spectra
+    unsigned int blocksize;
+    unsigned int hop;
+    // number of complex bins per spectrum (blocksize/2+1) and of channels
+    unsigned int bins;
+    unsigned int channels;
+    // the analysis and synthesis window (blocksize values); it includes the
+    // 1/sqrt(blocksize) share of the FFT normalization
+    const double *window;
+};
+
+// Processing statistics of a decoder, accumulated since Init() or the last
+// call to reset_statistics().
+struct decoder_statistics
+{
+    // number of blocks (hops) processed, and how many of them were skipped
+    // by the silence gate
+    unsigned long long blocks;
+    unsigned long long silent_blocks;
+    // number of blocks decoded by the shortcut for fully correlated input
+    unsigned long long correlated_blocks;
+    // number of bins steered bin by bin, and how many of them fell below
+    // the sparse threshold and were placed in the center instead
+    unsigned long long bins;
+    unsigned long long sparse_bins;
+    // number of blocks decoded as a sequence of short blocks (see
+    // DPL2FSDecoder::set_block_switching)
+    unsigned long long short_blocks;
+};
+
+// The soundfield parameters that steering depends on (see the setters of
+// DPL2FSDecoder).
+struct steering_parameters
+{
+    // angle of the front soundstage around the listener (90\B0=default)
+    float circular_wrap;
+
+    // forward/backward offset of the soundstage
+    float shift;
+
+    // backward extension of the soundstage
+    float depth;
+
+    // localization of the sound events
+    float focus;
+
+    // presence of the center speaker
+    float center_image;
+
+    // front stereo separation
+    float front_separation;
+
+    // rear stereo separation
+    float rear_separation;
+};
+
 // The FreeSurround decoder.
 
 class DPL2FSDecoder
@@ -76,16 +179,52 @@ public:
     // @param setup The output channel setup -- determines the number of output
     // channels and their place in the sound field.
     // @param blocksize Granularity at which data is processed by the decode()
-    // function. Must be a power of two and should correspond to ca. 10ms worth
-    // of single-channel samples (default is 4096 for 44.1Khz data). Do not make
-    // it shorter or longer than 5ms to 20ms since the granularity at which
-    // locations are decoded changes with this.
+    // function. Must be even (the decoder stays uninitialized otherwise) and
+    // should correspond to ca. 10ms worth of single-channel samples (default
+    // is 4096 for 44.1Khz data). Do not make it shorter or longer than 5ms to
+    // 20ms since the granularity at which locations are decoded changes with
+    // this. Sizes whose only prime factors are 2, 3 and 5 (e.g. 480 or 960 at
+    // 48 kHz) are as fast as powers of two; other factors (e.g. the 7 in 882
+    // for 20ms at 44.1 kHz) work but are transformed more slowly.
     DPL2FSDecoder();
     ~DPL2FSDecoder();
 
+    // Decoders can be moved (e.g. into containers), which takes over all
+    // buffers without allocating; neither decoder may be in use by another
+    // thread at the time. The moved-from decoder is left uninitialized and
+    // may be Init()ed again. Copying is not supported.
+    DPL2FSDecoder(DPL2FSDecoder &&other) noexcept;
+    DPL2FSDecoder &operator=(DPL2FSDecoder &&other) noexcept;
+    DPL2FSDecoder(const DPL2FSDecoder &) = delete;
+    DPL2FSDecoder &operator=(const DPL2FSDecoder &) = delete;
+
     void Init(channel_setup chsetup = channel_setup::cs_5point1, unsigned int blocksize = 4096,
               unsigned int sample_rate = 48000);
 
+    // Switch an initialized decoder to another channel setup, blocksize or
+    // sample rate, keeping all parameters (frequencies stay the same in Hz)
+    // and the buffers allocated so far. Nothing is allocated as long as the
+    // new configuration fits within what was reserved (see reserve()), so
+    // this may run on the audio thread between two decode() calls. If only
+    // the channel setup changes, decoding goes on seamlessly: the pending
+    // output of the channels that both setups share carries over, and
+    // channels that are new fade in with their first block. A new blocksize
+    // or sample rate starts over, as flush() does, keeping the overlap mode
+    // (see set_overlap and set_low_latency) if it fits the new blocksize.
+    // Behaves like Init() on an uninitialized decoder.
+    void reconfigure(channel_setup chsetup, unsigned int blocksize, unsigned int sample_rate);
+
+    // reserve the buffers for blocksizes up to max_blocksize and for the
+    // largest channel setup, so that later reconfigure() calls within these
+    // limits do not allocate (except for the sliding analysis, which is set
+    // up anew for another blocksize); this covers block switching, too, once
+    // it is on
+    void reserve(unsigned int max_blocksize);
+
+    // the smallest fast blocksize (even, with no prime factors but 2, 3 and
+    // 5) of at least n, e.g. for sizing blocks by duration
+    static unsigned int fast_blocksize(unsigned int n);
+
     // Decode a chunk of stereo sound. The output is delayed by half of the
     // blocksize. This function is the only one needed for straightforward
     // decoding.
@@ -96,11 +235,83 @@ public:
     // output channels in the chosen channel setup.
     float *decode(const float *input);
 
+    // Decode a chunk of integer PCM stereo sound. Same as above, but the input
+    // is full-scale 16-bit, packed 24-bit or 32-bit PCM; scaling to [-1,1) is
+    // done while windowing, so no float copy of the input is needed.
+    float *decode(const std::int16_t *input);
+    float *decode(const pcm24 *input);
+    float *decode(const std::int32_t *input);
+
+    // Decode a chunk of stereo sound into a caller-provided buffer. The output
+    // is written directly by the synthesis stage, in the sample format and
+    // channel order selected with set_output_format().
+    // @param output Receives exactly blocksize (multiplexed) multichannel
+    // samples.
+    void decode(const float *input, void *output);
+    void decode(const std::int16_t *input, void *output);
+    void decode(const pcm24 *input, void *output);
+    void decode(const std::int32_t *input, void *output);
+
+    // Analyze one hop of stereo sound into per-channel spectra, without
+    // synthesizing it. Each decode() call amounts to blocksize/layout().hop
+    // such hops (two by default); the two interfaces share their state and
+    // may be mixed.
+    // @param input Contains exactly layout().hop (multiplexed) stereo samples.
+    void analyze(const float *input);
+    void analyze(const std::int16_t *input);
+    void analyze(const pcm24 *input);
+    void analyze(const std::int32_t *input);
+
+    // Analyze one hop given as precomputed Lt/Rt spectra, skipping windowing
+    // and the forward transforms. To match time-domain input, each spectrum
+    // must be the unnormalized forward real FFT (as kiss_fftr computes it) of
+    // blocksize frames multiplied by layout().window (by default a periodic
+    // sqrt-Hann window scaled by 1/sqrt(blocksize)), with consecutive spectra
+    // layout().hop frames apart. The time-domain input history is left as is.
+    // @param lt, rt Contain exactly blocksize/2+1 bins each.
+    void analyze(const cplx *lt, const cplx *rt);
+
+    // Decode one hop given as Lt/Rt spectra (see above), writing layout().hop
+    // multichannel samples to output as synthesize() does.
+    void decode(const cplx *lt, const cplx *rt, void *output);
+
+    // The spectrum of output channel c from the last analyze() call, with
+    // layout().bins bins (DC and Nyquist are always zero). Read-only and valid
+    // until the next call that decodes; nullptr if the channel is silent.
+    [[nodiscard]] const cplx *spectrum(unsigned int c) const;
+
+    // Synthesize the hop analyzed last, either from the decoder's own spectra
+    // or from per-channel replacements (nullptr entries are silent), and
+    // overlap-add it into the output.
+    // @param output Receives exactly layout().hop (multiplexed) multichannel
+    // samples, formatted as selected with set_output_format().
+    void synthesize(void *output);
+    void synthesize(const cplx *const *spectra, void *output);
+
+    // the layout of the spectra handed out by spectrum()
+    [[nodiscard]] spectral_layout layout() const;
+
+    // the current configuration
+    [[nodiscard]] decoder_config config() const;
+
     // Flush the internal buffer.
     void flush();
 
+    // Set all parameters back to their defaults after Init(), keeping the
+    // configuration: steering, cutoffs, thresholds, channel mask, output
+    // format and overlap, with sliding analysis, block switching and parallel
+    // decoding off. The streaming state starts over, as with set_overlap();
+    // nothing is allocated.
+    void reset_parameters();
+
     // set soundfield & rendering parameters
     // for more information, see full FreeSurround source code
+    // The steering parameters (circular_wrap to rear_separation) may be set
+    // from a control thread while another thread decodes: they are handed
+    // over lock-free as a whole and take effect at the next block boundary
+    // (hop), so a block never sees a half-applied change. There may be only
+    // one such control thread; the other setters must not run concurrently
+    // with decoding.
     void set_circular_wrap(float v);
     void set_shift(float v);
     void set_depth(float v);
@@ -112,12 +323,166 @@ public:
     void set_high_cutoff(float v);
     void set_bass_redirection(bool v);
 
+    // set all steering parameters at once, as a single change (see above)
+    void set_steering_parameters(const steering_parameters &v);
+
+    // glide the steering parameters linearly from their current values to
+    // newly set ones over the given number of blocks (hops) instead of
+    // jumping there at the next block (default: 0)
+    void set_steering_glide(unsigned int blocks);
+
+    // select the output channels to render, as a combination of channel_id
+    // bits (all channels of the setup by default); masked-off channels are
+    // output as silence and cost no steering, back-transform or overlap-add
+    void set_channel_mask(unsigned int mask);
+
+    // set the format of the output written by decode(input, output); dither
+    // enables TPDF dithering for the integer formats
+    void set_output_format(sample_format format, channel_order order = channel_order::co_native,
+                           bool dither = false);
+
+    // enable the shortcut for blocks whose Lt and Rt are identical up to a
+    // gain (e.g., mono sources): all bins then decode to the same position, so
+    // the channel gains are computed once per block (default: on)
+    void set_correlation_shortcut(bool v);
+
+    // set the RMS level (in dBFS) at or below which input counts as silent;
+    // blocks whose input is silent skip the transforms and the steering and
+    // only drain pending output (default: -inf, i.e. digital silence only)
+    void set_silence_threshold(float v);
+
+    // set the level (in dB relative to the loudest bin of the block) below
+    // which bins are not steered but placed in the center (default: -inf,
+    // i.e. all bins are steered; -80 is inaudible on most content)
+    void set_sparse_threshold(float v);
+
+    // set the frequency range (in Hz) over which bins are steered; bins
+    // outside of it (e.g., the empty top of band-limited sources) are placed
+    // in the center instead (default: 0 to samplerate/2, i.e. all bins)
+    void set_processing_range(float lo, float hi);
+
+    // set the width (in ERB) of the perceptual bands whose bins are steered
+    // as a whole: the position is computed once per band from its pooled
+    // Lt/Rt cues and the channel levels are interpolated between band
+    // centers; this is far cheaper at large block sizes, e.g. 0.5 for
+    // N=16384 at 192 kHz (default: 0, i.e. each bin is steered on its own)
+    void set_band_resolution(float v);
+
+    // switch to low-latency processing with the given hop (in samples; a
+    // divisor of blocksize of at most blocksize/2), or back to the regular
+    // half-block hop with 0. The analysis window keeps its full blocksize, and
+    // thus the frequency resolution, but falls off asymmetrically over its
+    // last hop, and synthesis only spans the last two hops of each block, so
+    // the output lags the input by a single hop. E.g., a hop of 128 at 48 kHz
+    // gives 5.3 ms of latency when fed hop by hop through analyze() and
+    // synthesize(). Resets the streaming state, as flush() does.
+    void set_low_latency(unsigned int hop);
+
+    // set the overlap factor of the (symmetric) blocks, i.e. blocksize/hop:
+    // 2 (default), 4 or 8, with the sqrt-Hann windows scaled to overlap-add
+    // to one. Higher factors smooth the steering over time at proportionally
+    // higher cost, e.g. for offline jobs. Leaves low-latency mode and resets
+    // the streaming state, as flush() does.
+    void set_overlap(unsigned int factor);
+
+    // compute the Lt/Rt spectra of each hop with a sliding DFT, which only
+    // processes the samples that entered or left the block, instead of two
+    // full forward transforms; it costs O(blocksize*hop) per hop and so only
+    // pays off for small hops (a few dozen samples with common block sizes).
+    // Resets the streaming state, as flush() does.
+    void set_sliding_analysis(bool v);
+
+    // switch blocks with transients over to short blocks of the given size (an
+    // even divisor of blocksize, e.g. 512 for 4096; 0 turns this off, the
+    // default) in decode(): a block counts as transient when the spectral
+    // power that newly appeared since the previous block exceeds the power of
+    // that block by the given threshold (in dB, e.g. 6). Such a block is
+    // re-analyzed as a series of half-overlapping short blocks, which are
+    // steered on their own and overlap-add to the block again, so stationary
+    // content keeps the long blocks and transients are not smeared across
+    // speakers. The bass that goes to the LFE channel (see
+    // set_bass_redirection) is still taken from the long block, whose bins
+    // are narrow enough to tell it apart.
+    void set_block_switching(unsigned int size, float threshold);
+
+    // runs task(0) ... task(count-1), possibly in parallel, and returns once
+    // all of them are done
+    using parallel_task = std::function<void(unsigned int index)>;
+    using parallel_executor = std::function<void(unsigned int count, const parallel_task &task)>;
+
+    // Split the decoding of blocks of at least min_blocksize samples into up
+    // to the given number of tasks, run by executor: the two forward
+    // transforms, the steering of the bins in the processing range (in
+    // contiguous ranges), and the back-transform and overlap-add of the
+    // channels. The output stays the same bit for bit; dithered output is
+    // synthesized serially, though, as its noise is drawn in channel order,
+    // and so are blocks whose channels share a spectrum (fully correlated
+    // ones), which take a single back-transform.
+    // One block takes long enough to be worth this only with large blocks and
+    // many channels, e.g. N=16384 and up with 7.1 in offline rendering; each
+    // task gets its own scratch buffers and inverse transform. No executor or
+    // fewer than two tasks turns this off (the default).
+    void set_parallel(parallel_executor executor, unsigned int tasks, unsigned int min_blocksize = 16384);
+
+    // the same on a TaskPool of the given number of threads (counting the one
+    // that decodes) that the decoder owns
+    void set_parallel(unsigned int threads, unsigned int min_blocksize = 16384);
+
     // number of samples currently held in the buffer
     [[nodiscard]] unsigned int buffered() const;
 
+    // number of frames by which the output lags the input (blocksize/2 by
+    // default, the hop in low-latency mode); the actual delay adds the size
+    // of the chunks fed in, i.e. blocksize frames for decode() and one hop
+    // for analyze()
+    [[nodiscard]] unsigned int latency_samples() const;
+
+    // processing statistics
+    [[nodiscard]] const decoder_statistics &statistics() const;
+    void reset_statistics();
+
 private:
+    // steers the bins of many decoders at once
+    friend class DecoderBatch;
+    // warms decoders up for segments of a recording
+    friend class OfflineDecoder;
+
     // constants
-    const float epsilon = 0.000001f;
+    static constexpr float epsilon = 0.000001f;
+
+    // a flag that a move hands over, clearing it in the moved-from object
+    class moved_flag
+    {
+    public:
+        moved_flag() = default;
+        moved_flag(moved_flag &&other) noexcept : value(std::exchange(other.value, false)) {}
+        moved_flag &operator=(moved_flag &&other) noexcept
+        {
+            value = std::exchange(other.value, false);
+            return *this;
+        }
+        moved_flag &operator=(const bool v)
+        {
+            value = v;
+            return *this;
+        }
+        operator bool() const { return value; }
+
+    private:
+        bool value = false;
+    };
+
+    // an atomic slot index whose value a move carries over
+    struct movable_slot : std::atomic<unsigned int>
+    {
+        movable_slot() = default;
+        movable_slot(movable_slot &&other) noexcept : std::atomic<unsigned int>(other.load(std::memory_order_relaxed)) {}
+        movable_slot &operator=(movable_slot &&other) noexcept
+        {
+            store(other.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+    };
 
     // number of samples per input/output block, number of output channels
     unsigned int N;
@@ -126,36 +491,107 @@ private:
 
     // the channel setup
     channel_setup setup;
-    bool initialized;
+    // its channel maps and the phase sign of each channel, looked up once
+    // per configuration (they are read for every bin)
+    const std::vector<std::vector<float *>> *setup_alloc;
+    const std::vector<float> *setup_xsf;
+    moved_flag initialized;
+
+    // steering parameters: as used by the block being decoded, the snapshot
+    // they glide towards, and the number of blocks to glide over and still to
+    // go (see set_steering_glide)
+    steering_parameters steering;
+    steering_parameters steering_target;
+    unsigned int glide_blocks;
+    unsigned int glide_left;
+
+    // steering parameter exchange with a control thread (a triple buffer):
+    // the control thread's copy, the three snapshot slots, the slot owned by
+    // either side, and the slot in between, with fresh_snapshot set when it
+    // holds a snapshot that the audio side has not taken yet
+    steering_parameters control;
+    std::array<steering_parameters, 3> snapshot;
+    unsigned int control_slot;
+    unsigned int audio_slot;
+    movable_slot middle_slot;
 
-    // parameters
-    // angle of the front soundstage around the listener (90\B0=default)
-    float circular_wrap;
+    // LFE cutoff frequencies
+    float lo_cut;
+    float hi_cut;
 
-    // forward/backward offset of the soundstage
-    float shift;
+    // level of the LFE channel for each bin below hi_cut, and whether it
+    // needs to be rebuilt after a cutoff change
+    std::vector<double> bass_weight;
+    bool bass_weight_stale;
+
+    // decimated LFE synthesis (see synthesize_lfe): the M-point inverse
+    // transform (nullptr: synthesized at full size), its buffers, and the
+    // phase shifts for each of the N/M sample offsets
+    kiss_fftr_cfg lfe_inverse;
+    std::vector<char> lfe_memory;
+    std::vector<cplx> lfe_spectrum;
+    std::vector<double> lfe_time;
+    std::vector<cplx> lfe_twiddle;
+
+    // processing range as set (in Hz), and the range of bins [first_bin,
+    // last_bin) that are steered
+    float range_lo;
+    float range_hi;
+    unsigned int first_bin;
+    unsigned int last_bin;
+
+    // band steering: band width in ERB (0: off), the first bin of each band
+    // (and last_bin), the channel levels of each band, and for each bin the
+    // band it is interpolated from and its offset towards the next one
+    float band_resolution;
+    bool bands_stale;
+    std::vector<unsigned int> band_edge;
+    std::vector<double> band_level;
+    std::vector<unsigned int> bin_band;
+    std::vector<double> bin_offset;
+
+    // channel levels of the bin being decoded
+    std::vector<double> level;
 
-    // backward extension of the soundstage
-    float depth;
+    // whether to use the LFE channel
+    bool use_lfe;
 
-    // localization of the sound events
-    float focus;
+    // silence gate: mean-square level at or below which a hop is silent, and
+    // the number of silent hops in a row (up to blocksize/hop)
+    double silence_level;
+    unsigned int silent_hops;
 
-    // presence of the center speaker
-    float center_image;
+    // whether to decode fully correlated blocks by the shortcut
+    bool correlation_shortcut;
 
-    // front stereo separation
-    float front_separation;
+    // sparse threshold as a power ratio, the power below which a bin of the
+    // current block is sparse, the power of each bin, and the channel gains
+    // of the center position
+    double sparse_level;
+    double sparse_limit;
+    std::vector<double> bin_power;
+    std::vector<double> center_gain;
 
-    // rear stereo separation
-    float rear_separation;
+    decoder_statistics stats;
 
-    // LFE cutoff frequencies
-    float lo_cut;
-    float hi_cut;
+    // the channel mask as set, and whether each channel is rendered at all
+    // (see set_channel_mask)
+    unsigned int channel_mask;
+    std::vector<bool> active;
 
-    // whether to use the LFE channel
-    bool use_lfe;
+    // whether each channel has a non-zero spectrum in the current block
+    std::vector<bool> audible;
+
+    // the spectrum of each channel for synthesis (nullptr: silent)
+    std::vector<const cplx *> spectra;
+
+    // all-silent spectra, for blocks skipped by the silence gate
+    std::vector<const cplx *> no_spectra;
+
+    // gain applied to each channel's spectrum in synthesis, and the spectrum
+    // that correlated blocks share between all channels but the LFE
+    std::vector<double> scale;
+    std::vector<cplx> basis;
 
     // FFT data structures
     // left total, right total (source arrays), time-domain destination buffer
@@ -168,22 +604,94 @@ private:
     std::vector<cplx> lf;
     std::vector<cplx> rf;
 
-    // FFT buffers
+    // FFT buffers, set up in memory owned by the decoder (see fft_setup)
     kiss_fftr_cfg forward;
     kiss_fftr_cfg inverse;
+    std::vector<char> forward_memory;
+    std::vector<char> inverse_memory;
+
+    // the scratch state of a parallel task (see set_parallel): the channel
+    // levels of the bin being steered, whether each channel got a non-zero
+    // bin, the number of sparse bins, and an inverse transform and its output
+    struct parallel_lane
+    {
+        std::vector<double> level;
+        std::vector<bool> audible;
+        unsigned long long sparse_bins = 0;
+        kiss_fftr_cfg inverse = nullptr;
+        std::vector<char> inverse_memory;
+        std::vector<double> dst;
+    };
+
+    // intra-block parallelism: the executor (empty: off), the smallest
+    // blocksize it is used for, the forward transform of Rt, and the lane of
+    // each task
+    parallel_executor executor;
+    unsigned int parallel_min;
+    kiss_fftr_cfg parallel_forward;
+    std::vector<char> parallel_forward_memory;
+    std::vector<parallel_lane> lanes;
 
     // buffers
     // whether the buffer is currently empty or dirty
     bool buffer_empty;
 
-    // stereo input buffer (multiplexed)
+    // last blocksize-hop frames of stereo input, kept for the next
+    // overlapping blocks (multiplexed)
     std::vector<float> inbuf;
 
     // multichannel output buffer (multiplexed)
     std::vector<float> outbuf;
 
-    // the window function, precomputed
+    // the part of the recent back-transformed blocks of each channel that is
+    // still to be overlap-added with the next ones (span-hop samples per
+    // channel)
+    std::vector<float> tail;
+
+    // output format of decode(input, output)
+    sample_format out_format;
+    channel_order out_order;
+    bool out_dither;
+
+    // position of each channel within an interleaved output frame, in the
+    // native and in the requested channel order
+    std::vector<unsigned int> native_slot;
+    std::vector<unsigned int> out_slot;
+
+    // state of the dither noise generator
+    std::uint32_t dither_state;
+
+    // the hop between blocks, and the number of samples at the end of each
+    // back-transformed block that are overlap-added (blocksize, unless in
+    // low-latency mode)
+    unsigned int hop;
+    unsigned int span;
+
+    // the analysis and synthesis window functions, precomputed
     std::vector<double> wnd;
+    std::vector<double> swnd;
+
+    // sliding-DFT analysis: whether it is used, the newest hop of stereo
+    // input (multiplexed), and the engines for Lt and Rt
+    bool sliding;
+    std::vector<double> fresh;
+    SlidingDFT sliding_lt;
+    SlidingDFT sliding_rt;
+
+    // block switching: the decoder that steers the short blocks (nullptr:
+    // off), the flux (as a power ratio) above which a block is transient, the
+    // power of each bin of the previous block, the window of the short
+    // blocks, and their overlap-added output for each channel (blocksize
+    // samples each) and whether it is non-zero
+    std::unique_ptr<DPL2FSDecoder> short_decoder;
+    double transient_level;
+    std::vector<double> last_power;
+    std::vector<double> short_window;
+    std::vector<double> short_out;
+    std::vector<bool> short_audible;
+    // the largest blocksize passed to reserve() (0: none), for which a short
+    // decoder created later is reserved as well
+    unsigned int reserved_blocksize;
 
     // the signal to be constructed in every channel, in the frequency domain
     // instantiate the decoder with a given channel setup and processing block
@@ -200,6 +708,20 @@ private:
     static inline float clamp(double x);
     static inline float sign(double x);
 
+    // convert a PCM sample to a float in [-1,1)
+    static inline float to_float(float x);
+    static inline float to_float(std::int16_t x);
+    static inline float to_float(pcm24 x);
+    static inline float to_float(std::int32_t x);
+
+    // convert a float in [-1,1] to an output sample, optionally dithered
+    static inline void to_sample(float x, float &y, float noise);
+    static inline void to_sample(float x, std::int16_t &y, float noise);
+    static inline void to_sample(float x, pcm24 &y, float noise);
+
+    // triangular (TPDF) dither noise in [-1,1] LSB
+    inline float tpdf();
+
     // get the distance of the soundfield edge, along a given angle
     static inline double edgedistance(double a);
 
@@ -207,8 +729,172 @@ private:
     // allocation grid
     static int map_to_grid(double &x);
 
-    // decode a block of data and overlap-add it into outbuf
-    void buffered_decode(const float *input);
+    // size all buffers for the given configuration
+    void configure(channel_setup chsetup, unsigned int blocksize, unsigned int sample_rate);
+
+    // set up a real FFT of size n in the given memory, growing it if needed
+    static kiss_fftr_cfg fft_setup(unsigned int n, bool inverse, std::vector<char> &memory);
+
+    // move the tail of each channel that old_setup shares with the current
+    // setup to the channel's new place, and clear it for the other channels
+    void remap_tail(channel_setup old_setup);
+
+    // set up the window of block switching for the current blocksizes and
+    // forget the power of the last block, then size its buffers
+    void reset_block_switching();
+
+    // size the output buffers of block switching for the current channel
+    // setup
+    void size_block_switching();
+
+    // size the lanes of the parallel tasks for the current configuration
+    void size_parallel();
+
+    // whether the current block is decoded in parallel (see set_parallel)
+    [[nodiscard]] bool parallel_block() const;
+
+    // analyze one hop of PCM data of any supported sample type
+    template <typename Sample>
+    void analyze_pcm(const Sample *input);
+
+    // decode a chunk of PCM data of any supported sample type into output;
+    // formatted selects the format set by set_output_format() over native
+    // float output
+    template <typename Sample>
+    void decode_pcm(const Sample *input, void *output, bool formatted);
+
+    // demultiplex, convert and window a block of stereo data into lt/rt; the
+    // first head samples come from the history buffer, the rest from input;
+    // returns the energy of the newest hop of the block
+    template <typename Sample>
+    double window_block(const float *history, unsigned int head, const Sample *input);
+
+    // update the silence gate with the energy of the newest hop and tell
+    // whether the whole block is silent
+    bool silent_block(double energy);
+
+    // keep the end of a decoded input chunk for overlapping with future blocks
+    template <typename Sample>
+    void keep_history(const Sample *input);
+
+    // decode the windowed block in lt/rt (unless silent), overlap-add it with
+    // the tail and write the completed hop to output, starting at the given
+    // frame
+    void buffered_decode(void *output, unsigned int frame, bool formatted, bool silent);
+
+    // the first part of buffered_decode(): transform the block and decode it
+    // right away if it is silent or transient; returns false if it is done
+    bool begin_block(void *output, unsigned int frame, bool formatted, bool silent);
+
+    // compute the multichannel spectra from the Lt/Rt spectra; shared allows
+    // channels to share one spectrum at different scales instead of each
+    // getting its own in signal
+    void spectral_decode(const cplx *lf, const cplx *rf, bool shared);
+
+    // the parts of spectral_decode(): everything up to the steering of the
+    // bins in the processing range (returns false if the block is done
+    // already), the steering of one of these bins, and what comes after; a
+    // bin is steered with the given channel levels as scratch space, marks
+    // the channels it makes audible in heard and counts itself in sparse if
+    // it is sparse
+    bool begin_spectral_decode(const cplx *lf, const cplx *rf, bool shared);
+    void steer_bin(unsigned int f, const cplx *lf, const cplx *rf, std::vector<double> &levels,
+                   std::vector<bool> &heard, unsigned long long &sparse);
+    void end_spectral_decode();
+
+    // steer the bins in the processing range in parallel, in contiguous
+    // ranges with a lane each
+    void parallel_steer(const cplx *lf, const cplx *rf);
+
+    // spectral_decode() for blocks where Lt is a real multiple of Rt; returns
+    // false if the block is not of that kind
+    bool correlated_decode(const cplx *lf, const cplx *rf, bool shared);
+
+    // get the channel levels into levels for a soundfield position, or for
+    // bin f from the levels of its band
+    void position_levels(double ampL, double ampR, double phaseDiff, std::vector<double> &levels);
+    void band_levels(unsigned int f, std::vector<double> &levels);
+
+    // hand the control thread's steering parameters over to the audio side
+    void publish_steering();
+
+    // take over a new steering snapshot, if any, and advance the glide
+    // towards it; called once per block
+    void update_steering();
+
+    // rebuild the band tables if the band layout has changed
+    void update_bands();
+
+    // place bin f in the center (see set_sparse_threshold), marking the
+    // channels it makes audible in heard
+    void sparse_bin(unsigned int f, cplx sum, double amp_total, std::vector<bool> &heard);
+
+    // move the bass share of bin f with total signal center to the LFE
+    // channel, if bass redirection is on
+    void redirect_bass(unsigned int f, cplx center, std::vector<bool> &heard);
+
+    // back-transform the given per-channel spectra (nullptr: silent) at the
+    // given scales (nullptr: unscaled), overlap-add them with the tail and
+    // write the completed hop to output
+    void synthesize_block(const cplx *const *spectra, const double *scales, void *output, unsigned int frame,
+                          bool formatted);
+
+    // overlap-add the back-transformed block of channel c (nullptr: silent),
+    // scaled by gain, with its tail and write the completed hop to output,
+    // starting at the given frame, in the format of synthesize_block()
+    void write_block(unsigned int c, const double *block, double gain, void *output, unsigned int frame,
+                     bool formatted);
+
+    // write_block() for a given sample type, one sample per frame
+    template <typename Sample>
+    void overlap_add(unsigned int c, const double *block, Sample *output, double gain, bool dither);
+
+    // compare the power spectrum in lf/rf with that of the previous block and
+    // tell whether the block is transient (see set_block_switching)
+    bool transient_block();
+
+    // decode the windowed block in lt/rt as a series of short blocks into
+    // short_out
+    void short_decode();
+
+    // send the bass of the long block to the LFE channel of short_out and
+    // take it out of lt/rt (for short_decode())
+    void split_bass();
+
+    // hand the current parameters on to the short-block decoder
+    void sync_short_decoder();
+
+    // map amp/phase differences to a soundfield position, with all soundfield
+    // controls applied
+    [[nodiscard]] std::tuple<double, double> steer(double ampDiff, double phaseDiff) const;
+
+    // look up a channel allocation map at grid position p/q and fractional
+    // offset x/y (with bilinear interpolation)
+    static inline double bilinear(const std::vector<float *> &a, int p, int q, double x, double y);
+
+    // level of the LFE channel at bin w (below the high cutoff)
+    [[nodiscard]] inline double bass_level(float w) const;
+
+    // switch to the given hop and synthesis span, with new windows and
+    // buffers
+    void set_hop(unsigned int h, unsigned int s);
+
+    // compute the analysis and synthesis windows for the current hop and span
+    void make_windows();
+
+    // the analysis window as sine pieces (see SlidingDFT)
+    [[nodiscard]] std::vector<SlidingDFT::piece> window_pieces() const;
+
+    // map the windowed block in lt/rt into lf/rf, unless silent (the sliding
+    // DFT is advanced either way)
+    void transform_block(bool silent);
+
+    // rebuild bass_weight and the LFE transform if the cutoffs have changed
+    void update_bass_weight();
+
+    // back-transform the (band-limited) LFE spectrum into out (N samples) by
+    // N/M small inverse transforms instead of one of size N
+    void synthesize_lfe(const cplx *spectrum, double *out);
 
     // transform amp/phase difference space into x/y soundfield space
     static std::tuple<double, double> transform_decode(double amp, double phase);
@@ -0,0 +1,77 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include "FreeSurroundDecoder.h"
+#include "TaskPool.h"
+
+// Decodes whole recordings (e.g. albums or soundtracks) offline, cut into
+// segments that are decoded in parallel, each by a decoder of its own. A
+// decoder's state only reaches back less than two blocks (its input history,
+// the pending overlap-add tail, the silence gate and the power of the last
+// block), so the decoder of each segment is warmed up on the two blocks that
+// precede it, and the stitched output is the same, bit for bit, as that of a
+// single decoder fed the whole recording. Two features carry state from
+// the start of the recording on and are decoded as a single segment: the
+// sliding analysis (see DPL2FSDecoder::set_sliding_analysis) and gliding
+// steering parameters (see DPL2FSDecoder::set_steering_glide).
+class OfflineDecoder
+{
+public:
+    // sets the parameters of a freshly initialized decoder
+    using setup_function = std::function<void(DPL2FSDecoder &decoder)>;
+
+    // Set up for the given configuration, as DPL2FSDecoder::Init(), with
+    // setup applied to every decoder after Init(), on the given number of
+    // threads (0 for one per hardware thread).
+    void Init(channel_setup chsetup = channel_setup::cs_5point1, unsigned int blocksize = 4096,
+              unsigned int sample_rate = 48000, setup_function setup = nullptr, unsigned int threads = 0);
+
+    // the smallest number of blocks per segment (default 64), which keeps
+    // the warm-up a small share of the work
+    void set_min_segment(unsigned int blocks);
+
+    // Decode a recording of the given number of blocks of blocksize stereo
+    // frames, as a fresh decoder's decode() would one block at a time, into
+    // as many blocks of blocksize multichannel frames (float, in the native
+    // channel order). Each call decodes a recording of its own. Returns false
+    // if not initialized.
+    bool decode(const float *input, std::size_t blocks, float *output);
+
+    // the layout of the decoders' output
+    [[nodiscard]] spectral_layout layout() const;
+
+    // the number of segments that a recording of the given number of blocks
+    // is cut into
+    [[nodiscard]] std::size_t segments(std::size_t blocks) const;
+
+private:
+    // number of blocks that a segment's decoder is warmed up on
+    static constexpr std::size_t warmup_blocks = 2;
+
+    // a decoder set up as the ones for the segments will be
+    void make_decoder(DPL2FSDecoder &decoder) const;
+
+    decoder_config config = {};
+    setup_function setup;
+    std::size_t min_segment = 64;
+    // for the layout and the parameters
+    DPL2FSDecoder prototype;
+    std::unique_ptr<TaskPool> pool;
+};
@@ -0,0 +1,99 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <complex>
+#include <vector>
+#include "KissFFTR.h"
+
+using cplx = std::complex<double>;
+
+// Incrementally updated windowed spectrum of a real signal, as kiss_fftr
+// would compute it for each block of a sliding block sequence. The analysis
+// window must be made of sine pieces; each piece is split into two complex
+// exponentials, whose running sums over the piece are updated with just the
+// samples that enter or leave it. Advancing by a hop thus costs
+// O(blocksize*hop) instead of a full transform, which pays off for small
+// hops.
+class SlidingDFT
+{
+public:
+    // a piece of the window: amplitude*sin(2*pi*(n-offset)/period) at the
+    // block positions n in [begin, end)
+    struct piece
+    {
+        unsigned int begin;
+        unsigned int end;
+        unsigned int period;
+        unsigned int offset;
+        double amplitude;
+    };
+
+    SlidingDFT() = default;
+    SlidingDFT(const SlidingDFT &) = delete;
+    SlidingDFT &operator=(const SlidingDFT &) = delete;
+    SlidingDFT(SlidingDFT &&) noexcept = default;
+    SlidingDFT &operator=(SlidingDFT &&) noexcept = default;
+
+    // set up for the given block size and window; starts from silence
+    void init(unsigned int blocksize, const std::vector<piece> &window);
+
+    // start over from silence
+    void reset();
+
+    // advance the block by hop samples, read from input at the given stride,
+    // and write the windowed spectrum of the new block (blocksize/2+1 bins)
+    // to spectrum unless it is nullptr
+    void advance(const double *input, unsigned int stride, unsigned int hop, cplx *spectrum);
+
+private:
+    // recompute the running sums from the block samples, discarding the
+    // rounding errors they have accumulated
+    void refresh();
+
+    // add the sample x at absolute position m to the sums of piece p
+    void accumulate(unsigned int p, unsigned long long m, double x);
+
+    // block size, window pieces
+    unsigned int N = 0;
+    std::vector<piece> pieces;
+
+    // the samples of the current block (a ring starting at head), and the
+    // absolute position of its first sample
+    std::vector<double> ring;
+    unsigned int head = 0;
+    unsigned long long position = 0;
+
+    // for each piece, the running sums over its samples x[m] of
+    // x[m]*exp(+-2*pi*i*m/period)*exp(-2*pi*i*f*m/N) for each bin f
+    // (with the + sign first)
+    std::vector<std::vector<cplx>> sums;
+
+    // exp(-2*pi*i*k/N), and exp(2*pi*i*k/period) for each piece
+    std::vector<cplx> twiddle;
+    std::vector<std::vector<cplx>> rotor;
+
+    // samples since the last refresh
+    unsigned int stale = 0;
+
+    // transform (set up in memory, which moves along with the object) and
+    // buffers for refresh()
+    kiss_fftr_cfg forward = nullptr;
+    std::vector<char> memory;
+    std::vector<double> modulated;
+    std::vector<cplx> cos_part;
+    std::vector<cplx> sin_part;
+};
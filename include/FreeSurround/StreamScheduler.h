@@ -0,0 +1,156 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FreeSurroundDecoder.h"
+
+// Per-stream counters of a StreamScheduler.
+struct stream_statistics
+{
+    // input blocks waiting to be decoded
+    std::size_t queued;
+    // blocks decoded, and those of them finished after their deadline
+    unsigned long long decoded;
+    unsigned long long deadline_misses;
+    // blocks refused because the queue was full
+    unsigned long long rejected;
+    // blocks decoded by a worker other than the stream's own
+    unsigned long long stolen;
+};
+
+// Decodes many streams concurrently on a pool of worker threads. Producers on
+// any thread submit input blocks to a stream's queue; the decoded blocks are
+// handed to the stream's sink on the worker thread. Each stream belongs to one
+// worker (its home, ideally pinned to one core), which decodes its blocks one
+// at a time in turn with the other streams it holds, so that the decoder's
+// state stays in that core's caches. A worker that runs out of work steals
+// ready streams from another worker only once that one has fallen behind (has
+// at least steal_threshold streams waiting); stolen streams return home
+// afterwards.
+class StreamScheduler
+{
+public:
+    // receives the decoded block (blocksize frames of interleaved float
+    // samples) of a stream, on a worker thread
+    using sink = std::function<void(unsigned int stream, const float *output)>;
+
+    // Create a scheduler for up to max_streams streams that queue up to
+    // queue_depth input blocks each, on the given number of worker threads
+    // (0 for one per hardware thread), optionally pinned to one core each
+    // (where the platform supports it).
+    StreamScheduler(unsigned int max_streams, unsigned int queue_depth = 4, unsigned int threads = 0,
+                    bool pin_threads = false);
+    ~StreamScheduler();
+    StreamScheduler(const StreamScheduler &) = delete;
+    StreamScheduler &operator=(const StreamScheduler &) = delete;
+
+    // Add a stream with an initialized decoder and the sink for its output.
+    // Blocks are due budget after their submission (one blocksize at the
+    // decoder's sample rate if zero). Returns the stream's index, or
+    // max_streams if the scheduler is full or the decoder not initialized.
+    // May be called while other streams are running, but not concurrently
+    // with itself.
+    unsigned int add_stream(DPL2FSDecoder &&decoder, sink output,
+                            std::chrono::microseconds budget = std::chrono::microseconds(0));
+
+    // Queue a block of blocksize stereo frames for decoding; returns false
+    // (and counts the block as rejected) if the stream's queue is full.
+    bool submit(unsigned int stream, const float *input);
+
+    // the counters of a stream
+    [[nodiscard]] stream_statistics statistics(unsigned int stream) const;
+
+    // the number of worker threads
+    [[nodiscard]] unsigned int threads() const;
+
+    // the number of ready streams another worker must have waiting before an
+    // idle worker steals from it (default 2), and how often an idle worker
+    // looks for such a worker (default 1 ms)
+    void set_steal_threshold(unsigned int v);
+    void set_steal_interval(std::chrono::microseconds v);
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct stream
+    {
+        DPL2FSDecoder decoder;
+        sink output;
+        clock::duration budget;
+        unsigned int home = 0;
+        unsigned int frames = 0;
+
+        // the queued blocks: a ring of queue_depth slots, of which count
+        // starting at head are in use, with their deadlines; scheduled is set
+        // while the stream is in a worker's ready queue or being decoded
+        mutable std::mutex lock;
+        std::vector<float> slots;
+        std::vector<clock::time_point> deadline;
+        unsigned int head = 0;
+        unsigned int count = 0;
+        bool scheduled = false;
+
+        unsigned long long decoded = 0;
+        unsigned long long deadline_misses = 0;
+        unsigned long long rejected = 0;
+        unsigned long long stolen = 0;
+    };
+
+    struct worker
+    {
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<unsigned int> ready;
+        std::thread thread;
+    };
+
+    // the loop of worker w
+    void run(unsigned int w);
+
+    // the next stream for worker w: from its own ready queue, or else stolen
+    // from the back of the longest one that has reached steal_threshold
+    bool take(unsigned int w, unsigned int &s, bool &stolen);
+
+    // put stream s into its home worker's ready queue
+    void schedule(unsigned int s);
+
+    // decode the oldest queued block of stream s
+    void decode_block(unsigned int s, bool stolen);
+
+    // pin the calling thread to the given core (if supported)
+    static void pin_thread(unsigned int core);
+
+    unsigned int max_streams;
+    unsigned int queue_depth;
+    std::unique_ptr<stream[]> streams;
+    std::atomic<unsigned int> stream_count = 0;
+    unsigned int next_home = 0;
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::atomic<unsigned int> steal_threshold = 2;
+    std::atomic<long long> steal_interval_us = 1000;
+    std::atomic<bool> stopping = false;
+};
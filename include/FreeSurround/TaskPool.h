@@ -0,0 +1,62 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads that run the tasks of a parallel loop: run() hands
+// out the task indices to its helper threads and to the calling thread, and
+// returns once all tasks are done. Nothing is allocated per run. It may be
+// used by one thread at a time.
+class TaskPool
+{
+public:
+    using task = std::function<void(unsigned int index)>;
+
+    // Create a pool of the given number of threads, counting the one that
+    // calls run() (0 for one per hardware thread).
+    explicit TaskPool(unsigned int threads = 0);
+    ~TaskPool();
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    // run f(0) ... f(count-1), in parallel, and wait for all of them
+    void run(unsigned int count, const task &f);
+
+    // the number of threads, including the calling one
+    [[nodiscard]] unsigned int threads() const;
+
+private:
+    // the loop of a helper thread
+    void work();
+
+    // the loop being run: its tasks, how many there are, the next to hand
+    // out, and how many are done
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const task *current = nullptr;
+    unsigned int count = 0;
+    unsigned int next = 0;
+    unsigned int done = 0;
+    bool stopping = false;
+
+    std::vector<std::thread> helpers;
+};
@@ -0,0 +1,153 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/AsyncDecoder.h"
+
+#include <algorithm>
+
+AsyncDecoder::AsyncDecoder(DPL2FSDecoder &&decoder, const unsigned int prefetch) :
+    decoder(std::move(decoder)), prefetch(std::max(prefetch, 1u))
+{
+    frames = this->decoder.config().blocksize;
+    if (frames == 0)
+        return;
+    shape = this->decoder.layout();
+    input.init(this->prefetch + 1, 2 * static_cast<std::size_t>(frames));
+    output.init(this->prefetch + 1, static_cast<std::size_t>(frames) * shape.channels);
+    worker = std::thread([this] { run(); });
+}
+
+AsyncDecoder::~AsyncDecoder()
+{
+    stopping = true;
+    signal();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool AsyncDecoder::push(const float *input_block)
+{
+    if (frames == 0)
+        return false;
+    const unsigned long long tag = pushes++;
+    if (input.full())
+    {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::copy_n(input_block, input.block, input.back());
+    input.back_tag() = tag;
+    input.pushed.fetch_add(1, std::memory_order_release);
+    signal();
+    return true;
+}
+
+bool AsyncDecoder::pop(float *output_block)
+{
+    if (frames == 0)
+        return false;
+    const unsigned long long call = pops++;
+    bool ready = false;
+    if (call >= prefetch)
+    {
+        // drop the blocks that came too late for their pop
+        const unsigned long long due = call - prefetch;
+        bool dropped = false;
+        for (; !output.empty() && output.front_tag() < due; dropped = true)
+            output.popped.fetch_add(1, std::memory_order_release);
+        ready = !output.empty() && output.front_tag() == due;
+        if (ready)
+        {
+            std::copy_n(output.front(), output.block, output_block);
+            output.popped.fetch_add(1, std::memory_order_release);
+        }
+        else
+            underflows.fetch_add(1, std::memory_order_relaxed);
+        if (ready || dropped)
+            signal();
+    }
+    if (!ready)
+        std::fill_n(output_block, output.block, 0.0f);
+    return ready;
+}
+
+bool AsyncDecoder::process(const float *input_block, float *output_block)
+{
+    push(input_block);
+    return pop(output_block);
+}
+
+async_statistics AsyncDecoder::statistics() const
+{
+    return {decoded.load(std::memory_order_relaxed), underflows.load(std::memory_order_relaxed),
+            overflows.load(std::memory_order_relaxed)};
+}
+
+spectral_layout AsyncDecoder::layout() const { return shape; }
+
+void AsyncDecoder::run()
+{
+    for (;;)
+    {
+        const unsigned int seen = epoch.load(std::memory_order_acquire);
+        if (stopping)
+            return;
+        if (input.empty() || output.full())
+        {
+            epoch.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+        std::copy_n(decoder.decode(input.front()), output.block, output.back());
+        output.back_tag() = input.front_tag();
+        input.popped.fetch_add(1, std::memory_order_release);
+        output.pushed.fetch_add(1, std::memory_order_release);
+        decoded.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// only the worker waits, so notify_one() suffices; it is cheap when nobody
+// waits
+void AsyncDecoder::signal()
+{
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_one();
+}
+
+void AsyncDecoder::ring::init(const unsigned int n, const std::size_t size)
+{
+    capacity = n;
+    block = size;
+    data.assign(capacity * block, 0.0f);
+    tags.assign(capacity, 0);
+}
+
+bool AsyncDecoder::ring::empty() const
+{
+    return popped.load(std::memory_order_relaxed) == pushed.load(std::memory_order_acquire);
+}
+
+bool AsyncDecoder::ring::full() const
+{
+    return pushed.load(std::memory_order_relaxed) - popped.load(std::memory_order_acquire) == capacity;
+}
+
+float *AsyncDecoder::ring::back() { return &data[pushed.load(std::memory_order_relaxed) % capacity * block]; }
+
+float *AsyncDecoder::ring::front() { return &data[popped.load(std::memory_order_relaxed) % capacity * block]; }
+
+unsigned long long &AsyncDecoder::ring::back_tag() { return tags[pushed.load(std::memory_order_relaxed) % capacity]; }
+
+unsigned long long &AsyncDecoder::ring::front_tag() { return tags[popped.load(std::memory_order_relaxed) % capacity]; }
@@ -544,6 +544,22 @@ constexpr std::array<std::array<float, 21>, 21> map_7point1_rs = {
      all_zeroes,
      all_zeroes}};
 
+// WAVE_FORMAT_EXTENSIBLE order, following the bits of the speaker mask
+constexpr std::array order_wave = {channel_id::ci_front_left,        channel_id::ci_front_right,
+                                   channel_id::ci_front_center,      channel_id::ci_lfe,
+                                   channel_id::ci_back_left,         channel_id::ci_back_right,
+                                   channel_id::ci_front_center_left, channel_id::ci_front_center_right,
+                                   channel_id::ci_back_center,       channel_id::ci_side_center_left,
+                                   channel_id::ci_side_center_right};
+
+// SMPTE/ITU order: fronts, LFE, side surrounds, rear surrounds
+constexpr std::array order_smpte = {channel_id::ci_front_left,        channel_id::ci_front_right,
+                                    channel_id::ci_front_center,      channel_id::ci_lfe,
+                                    channel_id::ci_side_center_left,  channel_id::ci_side_center_right,
+                                    channel_id::ci_back_left,         channel_id::ci_back_right,
+                                    channel_id::ci_front_center_left, channel_id::ci_front_center_right,
+                                    channel_id::ci_back_center};
+
 constexpr std::array map_lfe_lfe = {all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes,
                                     all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes,
                                     all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes, all_zeroes};
@@ -580,6 +596,15 @@ std::map<unsigned, std::vector<channel_id>> init_chn_id()
     return temp_chn_id;
 }
 
+std::map<unsigned, std::vector<channel_id>> init_chn_order()
+{
+    std::map<unsigned, std::vector<channel_id>> temp_chn_order;
+    temp_chn_order[std::to_underlying(channel_order::co_native)] = {};
+    temp_chn_order[std::to_underlying(channel_order::co_wave)] = {std::begin(order_wave), std::end(order_wave)};
+    temp_chn_order[std::to_underlying(channel_order::co_smpte)] = {std::begin(order_smpte), std::end(order_smpte)};
+    return temp_chn_order;
+}
+
 std::map<unsigned, alloc_lut> init_chn_alloc()
 {
     std::map<unsigned, alloc_lut> temp_chn_alloc;
@@ -604,4 +629,5 @@ const auto chn_angle = init_chn_angle();
 const auto chn_xsf = init_chn_xsf();
 const auto chn_ysf = init_chn_ysf();
 const auto chn_id = init_chn_id();
+const auto chn_order = init_chn_order();
 const auto chn_alloc = init_chn_alloc();
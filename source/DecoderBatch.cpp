@@ -0,0 +1,299 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/DecoderBatch.h"
+#include "../include/FreeSurround/ChannelMaps.h"
+#include "../include/FreeSurround/Denormals.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+// a value clamped to [-1, 1] and rounded to single precision, as
+// DPL2FSDecoder::clamp() returns it
+static double clamp_lane(const double x) { return static_cast<float>(x < 1 ? (x > -1 ? x : -1) : 1); }
+
+// the angle of (x, y) for y >= 0, in [0, pi]; atan() of the ratio of the
+// smaller to the larger coordinate is Cephes' rational approximation, with
+// the range reduction done by selects rather than branches
+static double angle_lane(const double y, const double x)
+{
+    constexpr double pi = std::numbers::pi;
+    const double ax = std::abs(x);
+    const double lo = ax < y ? ax : y;
+    const double hi = ax < y ? y : ax;
+    double t = hi > 0 ? lo / hi : 0;
+    const bool upper = t > 0.66;
+    t = upper ? (t - 1) / (t + 1) : t;
+    const double z = t * t;
+    const double p = (((-8.750608600031904122785e-1 * z - 1.615753718733365076637e1) * z - 7.500855792314704667340e1) * z -
+                      1.228866684490136173410e2) * z - 6.485021904942025371773e1;
+    const double q = ((((z + 2.485846490142306297962e1) * z + 1.650270098316988542046e2) * z + 4.328810604912902668951e2) * z +
+                      4.853903996359136964868e2) * z + 1.945506571482613964425e2;
+    double a = t * z * p / q + t + (upper ? pi / 4 + 0.5 * 6.123233995736765886130e-17 : 0);
+    a = ax < y ? pi / 2 - a : a;
+    return x < 0 ? pi - a : a;
+}
+
+void DecoderBatch::Init(const unsigned int count, const channel_setup chsetup, const unsigned int blocksize,
+                        const unsigned int sample_rate)
+{
+    streams.clear();
+    streams.resize(count);
+    for (DPL2FSDecoder &d : streams)
+        d.Init(chsetup, blocksize, sample_rate);
+    config = count ? streams[0].config() : decoder_config{};
+    lockstep.reserve(count);
+    steered.reserve(count);
+}
+
+unsigned int DecoderBatch::size() const { return static_cast<unsigned int>(streams.size()); }
+
+DPL2FSDecoder &DecoderBatch::stream(const unsigned int s) { return streams[s]; }
+
+void DecoderBatch::decode(const float *const *inputs, void *const *outputs) { decode_pcm(inputs, outputs); }
+void DecoderBatch::decode(const std::int16_t *const *inputs, void *const *outputs) { decode_pcm(inputs, outputs); }
+void DecoderBatch::decode(const pcm24 *const *inputs, void *const *outputs) { decode_pcm(inputs, outputs); }
+void DecoderBatch::decode(const std::int32_t *const *inputs, void *const *outputs) { decode_pcm(inputs, outputs); }
+
+// DPL2FSDecoder::decode_pcm() for all lock-step streams at once, with the
+// steering of the blocks that need it gathered into steer_lanes()
+template <typename Sample>
+void DecoderBatch::decode_pcm(const Sample *const *inputs, void *const *outputs)
+{
+    if (config.blocksize == 0)
+        return;
+    const DenormalScope ftz;
+
+    // the streams that still have the configuration and overlap of the
+    // batch go in lock-step, the others on their own
+    lockstep.clear();
+    unsigned int hop = 0;
+    for (unsigned int s = 0; s < streams.size(); s++)
+    {
+        DPL2FSDecoder &d = streams[s];
+        if (d.config() == config && (hop == 0 || d.hop == hop))
+        {
+            hop = d.hop;
+            lockstep.push_back(s);
+        }
+        else
+            d.decode_pcm(inputs[s], outputs[s], true);
+    }
+    // all streams may have been reconfigured
+    if (lockstep.empty())
+        return;
+
+    const unsigned int N = config.blocksize;
+    for (unsigned int frame = 0; frame < N; frame += hop)
+    {
+        steered.clear();
+        for (const unsigned int s : lockstep)
+        {
+            DPL2FSDecoder &d = streams[s];
+            const bool silent = d.silent_block(d.window_block(d.inbuf.data() + frame * 2, N - hop - frame, inputs[s]));
+            if (!d.begin_block(outputs[s], frame, true, silent))
+                continue;
+            if (d.begin_spectral_decode(&d.lf[0], &d.rf[0], true))
+            {
+                // bands are steered as a whole, and the lanes share the
+                // processing range
+                const DPL2FSDecoder &lead = streams[lockstep[0]];
+                if (d.band_resolution == 0 && d.first_bin == lead.first_bin && d.last_bin == lead.last_bin)
+                {
+                    steered.push_back(s);
+                    continue;
+                }
+                for (unsigned int f = d.first_bin; f < d.last_bin; f++)
+                    d.steer_bin(f, &d.lf[0], &d.rf[0], d.level, d.audible, d.stats.sparse_bins);
+                d.end_spectral_decode();
+            }
+            d.synthesize_block(&d.spectra[0], &d.scale[0], outputs[s], frame, true);
+        }
+        for (unsigned int i = 0; i < steered.size(); i += batch_width)
+            steer_lanes(&steered[i], std::min<unsigned int>(batch_width, static_cast<unsigned int>(steered.size()) - i));
+        for (const unsigned int s : steered)
+        {
+            DPL2FSDecoder &d = streams[s];
+            d.end_spectral_decode();
+            d.synthesize_block(&d.spectra[0], &d.scale[0], outputs[s], frame, true);
+        }
+    }
+    for (const unsigned int s : lockstep)
+        streams[s].keep_history(inputs[s]);
+}
+
+// DPL2FSDecoder::steer_bin() for the bins of up to batch_width streams, one
+// per lane; lanes past count repeat the last stream and are not written back
+void DecoderBatch::steer_lanes(const unsigned int *lanes, const unsigned int count)
+{
+    constexpr unsigned int W = batch_width;
+    DPL2FSDecoder *d[W];
+    for (unsigned int s = 0; s < W; s++)
+        d[s] = &streams[lanes[std::min(s, count - 1)]];
+    const DPL2FSDecoder &lead = *d[0];
+    const unsigned int C = lead.C;
+    const alloc_lut &alloc = *lead.setup_alloc;
+    const std::vector<float> &xsf = *lead.setup_xsf;
+
+    // the steering parameters of each lane; wrap and focus are rare and not
+    // worth vectorizing, so they are applied lane by lane
+    double shift[W], depth[W], front[W], rear[W];
+    bool wrap = false;
+    bool focus = false;
+    for (unsigned int s = 0; s < W; s++)
+    {
+        const steering_parameters &p = d[s]->steering;
+        shift[s] = p.shift;
+        depth[s] = p.depth;
+        front[s] = p.front_separation;
+        rear[s] = p.rear_separation;
+        wrap = wrap || p.circular_wrap != 90;
+        focus = focus || p.focus != 0;
+    }
+
+    for (unsigned int f = lead.first_bin; f < lead.last_bin; f++)
+    {
+        double lr[W], li[W], rr[W], ri[W];
+        for (unsigned int s = 0; s < W; s++)
+        {
+            lr[s] = d[s]->lf[f].real();
+            li[s] = d[s]->lf[f].imag();
+            rr[s] = d[s]->rf[f].real();
+            ri[s] = d[s]->rf[f].imag();
+        }
+
+        // amplitude and phase differences, as in position_levels(); the phase
+        // difference (folded into [0, pi]) is the angle of Lt*conj(Rt), or of
+        // the one that is not zero
+        double x[W], y[W], amp_total[W];
+        for (unsigned int s = 0; s < W; s++)
+        {
+            const double amp_l = std::sqrt(static_cast<float>(lr[s] * lr[s]) + static_cast<float>(li[s] * li[s]));
+            const double amp_r = std::sqrt(static_cast<float>(rr[s] * rr[s]) + static_cast<float>(ri[s] * ri[s]));
+            amp_total[s] = std::sqrt(amp_l * amp_l + amp_r * amp_r);
+            const double a =
+                clamp_lane(amp_l + amp_r < DPL2FSDecoder::epsilon ? 0 : (amp_r - amp_l) / (amp_r + amp_l));
+            const bool l_zero = lr[s] == 0 && li[s] == 0;
+            const bool r_zero = rr[s] == 0 && ri[s] == 0;
+            const double re = l_zero ? rr[s] : r_zero ? lr[s] : lr[s] * rr[s] + li[s] * ri[s];
+            const double im = l_zero ? ri[s] : r_zero ? li[s] : li[s] * rr[s] - lr[s] * ri[s];
+            const double p = angle_lane(std::abs(im), re);
+
+            // calculate_x() and calculate_y(), with the powers multiplied out
+            const double p2 = p * p;
+            const double p3 = p2 * p;
+            const double p4 = p2 * p2;
+            const double p5 = p4 * p;
+            const double p6 = p3 * p3;
+            const double p7 = p4 * p3;
+            const double p8 = p4 * p4;
+            const double p9 = p8 * p;
+            const double p12 = p8 * p4;
+            const double p15 = p12 * p3;
+            const double p16 = p8 * p8;
+            const double a2 = a * a;
+            const double a3 = a2 * a;
+            const double a4 = a2 * a2;
+            const double a5 = a4 * a;
+            const double a7 = a5 * a2;
+            const double a8 = a4 * a4;
+            const double a10 = a8 * a2;
+            x[s] = clamp_lane(1.0047 * a + 0.46804 * a * p3 - 0.2042 * a * p4 + 0.0080586 * a * p7 -
+                              0.0001526 * a * p8 - 0.073512 * a3 * p + 0.2499 * a3 * p4 - 0.016932 * a3 * p7 +
+                              0.00027707 * a3 * p7 + 0.048105 * a5 * p7 - 0.0065947 * a5 * p12 + 0.0016006 * a5 * p15 -
+                              0.0071132 * a7 * p9 + 0.0022336 * a7 * p15 - 0.0004804 * a8 * p16);
+            y[s] = clamp_lane(0.98592 - 0.62237 * p + 0.077875 * p2 - 0.0026929 * p5 + 0.4971 * a2 * p -
+                              0.00032124 * a2 * p6 + 9.2491e-006 * a4 * p7 + 0.051549 * a8 + 1.0727e-014 * a10);
+        }
+
+        // the soundfield controls, as in steer()
+        if (wrap)
+            for (unsigned int s = 0; s < W; s++)
+                DPL2FSDecoder::transform_circular_wrap(x[s], y[s], d[s]->steering.circular_wrap);
+        for (unsigned int s = 0; s < W; s++)
+        {
+            y[s] = clamp_lane(y[s] - shift[s]);
+            y[s] = clamp_lane(1 - (1 - y[s]) * depth[s]);
+        }
+        if (focus)
+            for (unsigned int s = 0; s < W; s++)
+                DPL2FSDecoder::transform_focus(x[s], y[s], d[s]->steering.focus);
+        for (unsigned int s = 0; s < W; s++)
+            x[s] = clamp_lane(x[s] * (front[s] * (1 + y[s]) / 2 + rear[s] * (1 - y[s]) / 2));
+
+        // grid cells and offsets, as in map_to_grid()
+        int p[W], q[W];
+        for (unsigned int s = 0; s < W; s++)
+        {
+            const double gx = (x[s] + 1) * 0.5 * (grid_res - 1);
+            const double gy = (y[s] + 1) * 0.5 * (grid_res - 1);
+            const double i = static_cast<float>(std::min<double>(grid_res - 2, std::floor(gx)));
+            const double j = static_cast<float>(std::min<double>(grid_res - 2, std::floor(gy)));
+            x[s] = gx - i;
+            y[s] = gy - j;
+            p[s] = static_cast<int>(i);
+            q[s] = static_cast<int>(j);
+        }
+
+        // the phases of Lt, Lt+Rt and Rt as unit phasors, in place of
+        // polar() of their atan2()
+        double ur[3][W], ui[3][W];
+        for (unsigned int s = 0; s < W; s++)
+        {
+            const double re[3] = {lr[s], lr[s] + rr[s], rr[s]};
+            const double im[3] = {li[s], li[s] + ri[s], ri[s]};
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                const double m = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+                ur[k][s] = m > 0 ? re[k] / m : 1;
+                ui[k][s] = m > 0 ? im[k] / m : 0;
+            }
+        }
+
+        // build the channel signals and write them back, with sparse bins
+        // done the usual way
+        bool sparse[W];
+        for (unsigned int s = 0; s < W; s++)
+            sparse[s] = d[s]->bin_power[f] < d[s]->sparse_limit;
+        for (unsigned int c = 0; c < C - 1; c++)
+        {
+            const std::vector<float *> &a = alloc[c];
+            const unsigned int k = xsf[c] > 0 ? 2 : xsf[c] < 0 ? 0 : 1;
+            for (unsigned int s = 0; s < count; s++)
+            {
+                if (sparse[s] || !d[s]->active[c])
+                    continue;
+                const double level = (1 - x[s]) * (1 - y[s]) * a[q[s]][p[s]] + x[s] * (1 - y[s]) * a[q[s]][p[s] + 1] +
+                    (1 - x[s]) * y[s] * a[q[s] + 1][p[s]] + x[s] * y[s] * a[q[s] + 1][p[s] + 1];
+                const double gain = amp_total[s] * level;
+                d[s]->signal[c][f] = cplx(gain * ur[k][s], gain * ui[k][s]);
+                d[s]->audible[c] = d[s]->audible[c] || gain != 0;
+            }
+        }
+        for (unsigned int s = 0; s < count; s++)
+        {
+            DPL2FSDecoder &e = *d[s];
+            if (sparse[s])
+            {
+                e.stats.sparse_bins++;
+                e.sparse_bin(f, e.lf[f] + e.rf[f], std::sqrt(e.bin_power[f]), e.audible);
+            }
+            else
+                e.redirect_bass(f, cplx(amp_total[s] * ur[1][s], amp_total[s] * ui[1][s]), e.audible);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/DecoderPool.h"
+
+// decoders are initialized outside the lock, so that other threads can go on
+void DecoderPool::prepare(const decoder_config &config, const unsigned int count)
+{
+    std::vector<DPL2FSDecoder> fresh(count);
+    for (DPL2FSDecoder &d : fresh)
+        d.Init(config.setup, config.blocksize, config.sample_rate);
+    const std::scoped_lock guard(lock);
+    std::vector<DPL2FSDecoder> &pool = decoders[config];
+    pool.reserve(pool.size() + count);
+    for (DPL2FSDecoder &d : fresh)
+        if (d.config().blocksize)
+            pool.push_back(std::move(d));
+}
+
+DPL2FSDecoder DecoderPool::acquire(const decoder_config &config)
+{
+    {
+        const std::scoped_lock guard(lock);
+        if (const auto it = decoders.find(config); it != decoders.end() && !it->second.empty())
+        {
+            DPL2FSDecoder d = std::move(it->second.back());
+            it->second.pop_back();
+            return d;
+        }
+    }
+    DPL2FSDecoder d;
+    d.Init(config.setup, config.blocksize, config.sample_rate);
+    return d;
+}
+
+void DecoderPool::release(DPL2FSDecoder &&decoder)
+{
+    const decoder_config config = decoder.config();
+    if (config.blocksize == 0)
+        return;
+    decoder.reset_parameters();
+    decoder.flush();
+    decoder.reset_statistics();
+    const std::scoped_lock guard(lock);
+    decoders[config].push_back(std::move(decoder));
+}
+
+std::size_t DecoderPool::idle(const decoder_config &config) const
+{
+    const std::scoped_lock guard(lock);
+    const auto it = decoders.find(config);
+    return it == decoders.end() ? 0 : it->second.size();
+}
+
+void DecoderPool::clear()
+{
+    std::map<decoder_config, std::vector<DPL2FSDecoder>> dropped;
+    {
+        const std::scoped_lock guard(lock);
+        dropped.swap(decoders);
+    }
+}
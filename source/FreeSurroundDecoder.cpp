@@ -18,55 +18,80 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "../include/FreeSurround/FreeSurroundDecoder.h"
 #include "../include/FreeSurround/ChannelMaps.h"
+#include "../include/FreeSurround/Denormals.h"
+#include "../include/FreeSurround/TaskPool.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstring>
+#include <limits>
+
+// steering snapshot exchange: the slot index bits and the flag for a
+// snapshot not yet taken by the audio side
+constexpr unsigned int slot_mask = 3;
+constexpr unsigned int fresh_snapshot = 4;
+
+// the fields of steering_parameters, for gliding between them
+constexpr std::array steering_fields = {
+    &steering_parameters::circular_wrap,    &steering_parameters::shift, &steering_parameters::depth,
+    &steering_parameters::focus,            &steering_parameters::center_image,
+    &steering_parameters::front_separation, &steering_parameters::rear_separation};
 
 // FreeSurround implementation
 // DPL2FSDecoder::Init() must be called before using the decoder.
 DPL2FSDecoder::DPL2FSDecoder()
 {
+    setup = channel_setup::cs_5point1;
     initialized = false;
     buffer_empty = true;
+    lfe_inverse = nullptr;
+    // so that a decoder can be moved before Init()
+    bass_weight_stale = true;
+    bands_stale = true;
+    use_lfe = false;
+    correlation_shortcut = false;
+    out_format = sample_format::sf_float;
+    out_order = channel_order::co_native;
+    out_dither = false;
+    sliding = false;
+    parallel_min = 0;
+    parallel_forward = nullptr;
+    reserved_blocksize = 0;
+    setup_alloc = nullptr;
+    setup_xsf = nullptr;
 }
 
-DPL2FSDecoder::~DPL2FSDecoder()
-{
-    kiss_fftr_free(forward);
-    kiss_fftr_free(inverse);
-}
+DPL2FSDecoder::~DPL2FSDecoder() = default;
+
+// the FFT setups live in the memory vectors, whose storage moves along
+DPL2FSDecoder::DPL2FSDecoder(DPL2FSDecoder &&other) noexcept = default;
+
+DPL2FSDecoder &DPL2FSDecoder::operator=(DPL2FSDecoder &&other) noexcept = default;
 
 void DPL2FSDecoder::Init(const channel_setup chsetup, const unsigned int blocksize, const unsigned int sample_rate)
 {
-    if (initialized)
+    // the real FFT needs an even size
+    if (initialized || blocksize < 2 || blocksize % 2 != 0)
         return;
 
-    setup = chsetup;
-    N = blocksize;
-    samplerate = sample_rate;
-
-    // Initialize the parameters
-    wnd = std::vector<double>(N);
-    inbuf = std::vector<float>(3 * N);
-    lt = std::vector<double>(N);
-    rt = std::vector<double>(N);
-    dst = std::vector<double>(N);
-    lf = std::vector<cplx>(N / 2 + 1);
-    rf = std::vector<cplx>(N / 2 + 1);
-    forward = kiss_fftr_alloc(N, 0, nullptr, nullptr);
-    inverse = kiss_fftr_alloc(N, 1, nullptr, nullptr);
-    C = chn_alloc.at(to_uint(setup)).size();
-
-    // Allocate per-channel buffers
-    outbuf.resize((N + N / 2) * C);
-    signal.resize(C, std::vector<cplx>(N));
-
-    // Init the window function
-    for (unsigned int k = 0; k < N; k++)
-        wnd[k] = sqrt(0.5 * (1 - cos(2 * pi * k / N)) / N);
+    configure(chsetup, blocksize, sample_rate);
+    dither_state = 1;
+    initialized = true;
+    reset_parameters();
+    reset_statistics();
+}
 
-    // set default parameters
+// the default parameters
+void DPL2FSDecoder::reset_parameters()
+{
+    if (!initialized)
+        return;
+    control_slot = 0;
+    audio_slot = 1;
+    middle_slot.store(2);
+    glide_blocks = 0;
+    glide_left = 0;
     set_circular_wrap(90);
     set_shift(0);
     set_depth(1);
@@ -74,11 +99,232 @@ void DPL2FSDecoder::Init(const channel_setup chsetup, const unsigned int blocksi
     set_center_image(1);
     set_front_separation(1);
     set_rear_separation(1);
+    update_steering();
     set_low_cutoff(40.0f / static_cast<float>(samplerate) * 2);
     set_high_cutoff(90.0f / static_cast<float>(samplerate) * 2);
     set_bass_redirection(false);
+    set_channel_mask(~0u);
+    set_correlation_shortcut(true);
+    set_silence_threshold(-std::numeric_limits<float>::infinity());
+    set_sparse_threshold(-std::numeric_limits<float>::infinity());
+    set_processing_range(0, std::numeric_limits<float>::infinity());
+    set_band_resolution(0);
+    sliding = false;
+    set_overlap(2);
+    set_output_format(sample_format::sf_float);
+    short_decoder.reset();
+    last_power.clear();
+    executor = nullptr;
+    lanes.clear();
+}
 
-    initialized = true;
+void DPL2FSDecoder::reconfigure(const channel_setup chsetup, const unsigned int blocksize,
+                                const unsigned int sample_rate)
+{
+    if (!initialized)
+    {
+        Init(chsetup, blocksize, sample_rate);
+        return;
+    }
+    if (blocksize < 2 || blocksize % 2 != 0)
+        return;
+    const channel_setup old_setup = setup;
+    const bool same_timing = blocksize == N && sample_rate == samplerate;
+    // the cutoffs are kept in bins, which change their width in Hz
+    const auto ratio = static_cast<float>(static_cast<double>(blocksize) / N * samplerate / sample_rate);
+    lo_cut *= ratio;
+    hi_cut *= ratio;
+    bass_weight_stale = true;
+    const unsigned int factor = N / hop;
+    const bool low_latency = span != N;
+
+    configure(chsetup, blocksize, sample_rate);
+    set_channel_mask(channel_mask);
+    set_output_format(out_format, out_order, out_dither);
+    set_processing_range(range_lo, range_hi);
+    if (same_timing)
+        remap_tail(old_setup);
+    else if (low_latency && hop <= N / 2 && N % hop == 0)
+        set_hop(hop, 2 * hop);
+    else if (N % factor == 0)
+        set_hop(N / factor, N);
+    else
+        set_hop(N / 2, N);
+    if (!short_decoder)
+        return;
+    // block switching goes on if its short blocks still fit
+    const unsigned int size = short_decoder->N;
+    if (size < N && N % size == 0)
+    {
+        short_decoder->reconfigure(setup, size, samplerate);
+        // a new setup alone keeps the window and the power of the last block,
+        // so that the next block is not taken for a transient
+        if (same_timing)
+            size_block_switching();
+        else
+            reset_block_switching();
+    }
+    else
+    {
+        short_decoder.reset();
+        last_power.clear();
+    }
+}
+
+void DPL2FSDecoder::reserve(const unsigned int max_blocksize)
+{
+    unsigned int channels = 0;
+    for (const auto &[id, ids] : chn_id)
+        channels = std::max(channels, static_cast<unsigned int>(ids.size()));
+    const unsigned int n = max_blocksize;
+    for (std::vector<double> *v : {&lt, &rt, &dst, &wnd, &swnd, &lfe_time})
+        v->reserve(n);
+    for (std::vector<double> *v : {&bin_power, &bin_offset, &last_power})
+        v->reserve(n / 2 + 1);
+    for (std::vector<double> *v : {&scale, &center_gain, &level})
+        v->reserve(channels);
+    bass_weight.reserve(n / 2);
+    band_level.reserve((n / 2 + 1) * channels);
+    for (std::vector<cplx> *v : {&lf, &rf, &basis, &lfe_spectrum, &lfe_twiddle})
+        v->reserve(n / 2 + 1);
+    inbuf.reserve(2 * n);
+    fresh.reserve(2 * n);
+    outbuf.reserve(n * channels);
+    tail.reserve(n * channels);
+    bin_band.reserve(n / 2 + 1);
+    band_edge.reserve(n / 2 + 2);
+    for (std::vector<unsigned int> *v : {&native_slot, &out_slot})
+        v->reserve(channels);
+    audible.reserve(channels);
+    active.reserve(channels);
+    spectra.reserve(channels);
+    no_spectra.reserve(channels);
+    if (signal.size() < channels)
+        signal.resize(channels);
+    for (std::vector<cplx> &v : signal)
+        v.reserve(n);
+    // short blocks are at most half as long as the long ones
+    short_window.reserve(n / 2);
+    short_out.reserve(n * channels);
+    short_audible.reserve(channels);
+    if (short_decoder)
+        short_decoder->reserve(n / 2);
+    reserved_blocksize = std::max(reserved_blocksize, n);
+
+    // the transforms live in their memory, so they are set up again if it
+    // had to move
+    std::size_t size = 0;
+    kiss_fftr_alloc(static_cast<int>(n), 0, nullptr, &size);
+    forward_memory.reserve(size);
+    kiss_fftr_alloc(static_cast<int>(n), 1, nullptr, &size);
+    inverse_memory.reserve(size);
+    lfe_memory.reserve(size);
+    if (!lanes.empty())
+        parallel_forward_memory.reserve(size);
+    for (parallel_lane &lane : lanes)
+    {
+        lane.level.reserve(channels);
+        lane.audible.reserve(channels);
+        lane.inverse_memory.reserve(size);
+        lane.dst.reserve(n);
+    }
+    if (initialized)
+    {
+        forward = fft_setup(N, false, forward_memory);
+        inverse = fft_setup(N, true, inverse_memory);
+        bass_weight_stale = true;
+        size_parallel();
+    }
+}
+
+unsigned int DPL2FSDecoder::fast_blocksize(const unsigned int n)
+{
+    return kiss_fftr_next_fast_size_real(static_cast<int>(n));
+}
+
+// size all buffers for a configuration; vectors keep their capacity, so
+// nothing is allocated within what they have held or reserved before
+void DPL2FSDecoder::configure(const channel_setup chsetup, const unsigned int blocksize,
+                              const unsigned int sample_rate)
+{
+    setup = chsetup;
+    N = blocksize;
+    samplerate = sample_rate;
+
+    // Initialize the parameters
+    lt.assign(N, 0);
+    rt.assign(N, 0);
+    dst.assign(N, 0);
+    lf.assign(N / 2 + 1, 0);
+    rf.assign(N / 2 + 1, 0);
+    forward = fft_setup(N, false, forward_memory);
+    inverse = fft_setup(N, true, inverse_memory);
+    setup_alloc = &chn_alloc.at(to_uint(setup));
+    setup_xsf = &chn_xsf.at(to_uint(setup));
+    C = setup_alloc->size();
+
+    // Allocate per-channel buffers
+    outbuf.assign(N * C, 0);
+    if (signal.size() < C)
+        signal.resize(C);
+    for (unsigned int c = 0; c < C; c++)
+        signal[c].assign(N, 0);
+    audible.assign(C, false);
+    spectra.assign(C, nullptr);
+    no_spectra.assign(C, nullptr);
+    scale.assign(C, 1);
+    basis.assign(N / 2 + 1, 0);
+    bin_power.assign(N / 2 + 1, 0);
+    center_gain.assign(C, 0);
+    bass_weight.reserve(N / 2);
+    level.assign(C, 0);
+    bin_band.assign(N / 2 + 1, 0);
+    bin_offset.assign(N / 2 + 1, 0);
+    native_slot.resize(C);
+    for (unsigned int c = 0; c < C; c++)
+        native_slot[c] = c;
+    size_parallel();
+}
+
+kiss_fftr_cfg DPL2FSDecoder::fft_setup(const unsigned int n, const bool inverse, std::vector<char> &memory)
+{
+    std::size_t size = 0;
+    kiss_fftr_alloc(static_cast<int>(n), inverse, nullptr, &size);
+    if (memory.size() < size)
+        memory.resize(size);
+    size = memory.size();
+    return kiss_fftr_alloc(static_cast<int>(n), inverse, memory.data(), &size);
+}
+
+// both setups list their channels in channel_id order, so the shared ones
+// keep their relative order and can be moved in place: from the back when
+// channels are added, from the front when they are removed
+void DPL2FSDecoder::remap_tail(const channel_setup old_setup)
+{
+    const std::vector<channel_id> &old_ids = chn_id.at(to_uint(old_setup));
+    const std::vector<channel_id> &ids = chn_id.at(to_uint(setup));
+    const unsigned int overlap = span - hop;
+    const auto move = [&](const unsigned int c)
+    {
+        float *t = &tail[c * overlap];
+        const auto old = std::ranges::find(old_ids, ids[c]);
+        if (old == old_ids.end())
+            std::fill(t, t + overlap, 0.0f);
+        else if (const float *from = &tail[(old - old_ids.begin()) * overlap]; from != t)
+            std::copy(from, from + overlap, t);
+    };
+    if (C > old_ids.size())
+    {
+        tail.resize(C * overlap);
+        for (unsigned int c = C; c-- > 0;)
+            move(c);
+    }
+    else
+    {
+        for (unsigned int c = 0; c < C; c++)
+            move(c);
+        tail.resize(C * overlap);
+    }
 }
 
 // decode a stereo chunk, produces a multichannel chunk of the same size
@@ -87,42 +333,386 @@ float *DPL2FSDecoder::decode(const float *input)
 {
     if (!initialized)
         return nullptr;
+    decode_pcm(input, &outbuf[0], false);
+    return &outbuf[0];
+}
 
-    // append incoming data to the end of the input buffer
-    memcpy(&inbuf[N], &input[0], 8 * N);
-    // process first and second half, overlapped
-    buffered_decode(&inbuf[0]);
-    buffered_decode(&inbuf[N]);
-    // shift last half of the input to the beginning (for overlapping with a
-    // future block)
-    memcpy(&inbuf[0], &inbuf[2 * N], 4 * N);
-    buffer_empty = false;
+float *DPL2FSDecoder::decode(const std::int16_t *input)
+{
+    if (!initialized)
+        return nullptr;
+    decode_pcm(input, &outbuf[0], false);
     return &outbuf[0];
 }
 
+float *DPL2FSDecoder::decode(const pcm24 *input)
+{
+    if (!initialized)
+        return nullptr;
+    decode_pcm(input, &outbuf[0], false);
+    return &outbuf[0];
+}
+
+float *DPL2FSDecoder::decode(const std::int32_t *input)
+{
+    if (!initialized)
+        return nullptr;
+    decode_pcm(input, &outbuf[0], false);
+    return &outbuf[0];
+}
+
+// decode a stereo chunk straight into the requested output format
+void DPL2FSDecoder::decode(const float *input, void *output) { decode_pcm(input, output, true); }
+void DPL2FSDecoder::decode(const std::int16_t *input, void *output) { decode_pcm(input, output, true); }
+void DPL2FSDecoder::decode(const pcm24 *input, void *output) { decode_pcm(input, output, true); }
+void DPL2FSDecoder::decode(const std::int32_t *input, void *output) { decode_pcm(input, output, true); }
+
+template <typename Sample>
+void DPL2FSDecoder::decode_pcm(const Sample *input, void *output, const bool formatted)
+{
+    if (!initialized)
+        return;
+    const DenormalScope ftz;
+
+    // process the chunk hop by hop, overlapped; all blocks but the last one
+    // overlap the tail of the previous chunk, the last one spans the whole
+    // input
+    for (unsigned int frame = 0; frame < N; frame += hop)
+        buffered_decode(output, frame, formatted,
+                        silent_block(window_block(inbuf.data() + frame * 2, N - hop - frame, input)));
+    keep_history(input);
+}
+
+template <typename Sample>
+void DPL2FSDecoder::keep_history(const Sample *input)
+{
+    for (unsigned int k = 0; k < inbuf.size(); k++)
+        inbuf[k] = to_float(input[hop * 2 + k]);
+    buffer_empty = false;
+}
+
+// analyze a stereo hop into per-channel spectra
+void DPL2FSDecoder::analyze(const float *input) { analyze_pcm(input); }
+void DPL2FSDecoder::analyze(const std::int16_t *input) { analyze_pcm(input); }
+void DPL2FSDecoder::analyze(const pcm24 *input) { analyze_pcm(input); }
+void DPL2FSDecoder::analyze(const std::int32_t *input) { analyze_pcm(input); }
+
+template <typename Sample>
+void DPL2FSDecoder::analyze_pcm(const Sample *input)
+{
+    if (!initialized)
+        return;
+    const DenormalScope ftz;
+
+    // the block overlaps the tail of the previous hops
+    const bool silent = silent_block(window_block(&inbuf[0], N - hop, input));
+    transform_block(silent);
+    if (silent)
+        spectra = no_spectra;
+    else
+        spectral_decode(&lf[0], &rf[0], false);
+    // keep the hop (for overlapping with future blocks)
+    std::copy(inbuf.begin() + hop * 2, inbuf.end(), inbuf.begin());
+    for (unsigned int k = 0; k < hop * 2; k++)
+        inbuf[inbuf.size() - hop * 2 + k] = to_float(input[k]);
+    buffer_empty = false;
+}
+
+// analyze a hop given in the spectral domain
+void DPL2FSDecoder::analyze(const cplx *lt, const cplx *rt)
+{
+    if (!initialized)
+        return;
+    const DenormalScope ftz;
+    spectral_decode(lt, rt, false);
+    buffer_empty = false;
+}
+
+void DPL2FSDecoder::decode(const cplx *lt, const cplx *rt, void *output)
+{
+    analyze(lt, rt);
+    synthesize(output);
+}
+
+const cplx *DPL2FSDecoder::spectrum(const unsigned int c) const { return spectra[c]; }
+
+// synthesize the last analyzed hop
+void DPL2FSDecoder::synthesize(void *output) { synthesize(spectra.data(), output); }
+
+void DPL2FSDecoder::synthesize(const cplx *const *spectra, void *output)
+{
+    if (!initialized)
+        return;
+    const DenormalScope ftz;
+    synthesize_block(spectra, nullptr, output, 0, true);
+}
+
+spectral_layout DPL2FSDecoder::layout() const { return {N, hop, N / 2 + 1, C, &wnd[0]}; }
+
+decoder_config DPL2FSDecoder::config() const
+{
+    if (!initialized)
+        return {setup, 0, 0};
+    return {setup, N, samplerate};
+}
+
 // flush the internal buffers
 void DPL2FSDecoder::flush()
 {
     memset(&outbuf[0], 0, outbuf.size() * 4);
+    memset(&tail[0], 0, tail.size() * 4);
     memset(&inbuf[0], 0, inbuf.size() * 4);
+    silent_hops = N / hop;
+    std::ranges::fill(last_power, 0.0);
+    if (sliding)
+    {
+        sliding_lt.reset();
+        sliding_rt.reset();
+    }
     buffer_empty = true;
 }
 
 // number of samples currently held in the buffer
-unsigned int DPL2FSDecoder::buffered() const { return buffer_empty ? 0 : N / 2; }
+unsigned int DPL2FSDecoder::buffered() const { return buffer_empty ? 0 : N - hop; }
+
+// the output lags by the part of the synthesis span that is not yet complete
+unsigned int DPL2FSDecoder::latency_samples() const { return span - hop; }
+
+// processing statistics
+const decoder_statistics &DPL2FSDecoder::statistics() const { return stats; }
+
+void DPL2FSDecoder::reset_statistics() { stats = {}; }
 
 // set soundfield & rendering parameters
-void DPL2FSDecoder::set_circular_wrap(const float v) { circular_wrap = v; }
-void DPL2FSDecoder::set_shift(const float v) { shift = v; }
-void DPL2FSDecoder::set_depth(const float v) { depth = v; }
-void DPL2FSDecoder::set_focus(const float v) { focus = v; }
-void DPL2FSDecoder::set_center_image(const float v) { center_image = v; }
-void DPL2FSDecoder::set_front_separation(const float v) { front_separation = v; }
-void DPL2FSDecoder::set_rear_separation(const float v) { rear_separation = v; }
-void DPL2FSDecoder::set_low_cutoff(const float v) { lo_cut = v * static_cast<float>(N / 2.0); }
-void DPL2FSDecoder::set_high_cutoff(const float v) { hi_cut = v * static_cast<float>(N / 2.0); }
+void DPL2FSDecoder::set_circular_wrap(const float v)
+{
+    control.circular_wrap = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_shift(const float v)
+{
+    control.shift = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_depth(const float v)
+{
+    control.depth = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_focus(const float v)
+{
+    control.focus = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_center_image(const float v)
+{
+    control.center_image = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_front_separation(const float v)
+{
+    control.front_separation = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_rear_separation(const float v)
+{
+    control.rear_separation = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_steering_parameters(const steering_parameters &v)
+{
+    control = v;
+    publish_steering();
+}
+void DPL2FSDecoder::set_low_cutoff(const float v)
+{
+    lo_cut = v * static_cast<float>(N / 2.0);
+    bass_weight_stale = true;
+}
+void DPL2FSDecoder::set_high_cutoff(const float v)
+{
+    hi_cut = v * static_cast<float>(N / 2.0);
+    bass_weight_stale = true;
+}
 void DPL2FSDecoder::set_bass_redirection(const bool v) { use_lfe = v; }
 
+void DPL2FSDecoder::set_steering_glide(const unsigned int v) { glide_blocks = v; }
+
+void DPL2FSDecoder::set_correlation_shortcut(const bool v) { correlation_shortcut = v; }
+
+void DPL2FSDecoder::set_silence_threshold(const float v) { silence_level = pow(10.0, v / 10.0); }
+
+void DPL2FSDecoder::set_sparse_threshold(const float v) { sparse_level = pow(10.0, v / 10.0); }
+
+void DPL2FSDecoder::set_processing_range(const float lo, const float hi)
+{
+    range_lo = lo;
+    range_hi = hi;
+    // bin f is centered at f*samplerate/N Hz
+    const auto bin_of = [this](const float v) { return static_cast<double>(v) * N / samplerate; };
+    first_bin = static_cast<unsigned int>(std::clamp(ceil(bin_of(lo)), 1.0, N / 2.0));
+    last_bin = static_cast<unsigned int>(std::clamp(floor(bin_of(hi)) + 1, static_cast<double>(first_bin), N / 2.0));
+    bands_stale = true;
+}
+
+void DPL2FSDecoder::set_band_resolution(const float v)
+{
+    band_resolution = v;
+    bands_stale = true;
+}
+
+void DPL2FSDecoder::set_low_latency(const unsigned int v)
+{
+    if (v == 0)
+        set_hop(N / 2, N);
+    else if (v <= N / 2 && N % v == 0)
+        set_hop(v, 2 * v);
+}
+
+void DPL2FSDecoder::set_overlap(const unsigned int v)
+{
+    if (v == 2 || v == 4 || v == 8)
+        set_hop(N / v, N);
+}
+
+// switch to a new hop and synthesis span; the streaming state starts over
+void DPL2FSDecoder::set_hop(const unsigned int h, const unsigned int s)
+{
+    if (N % h != 0)
+        return;
+    hop = h;
+    span = s;
+    make_windows();
+    inbuf.assign((N - hop) * 2, 0);
+    tail.assign((span - hop) * C, 0);
+    fresh.resize(hop * 2);
+    if (sliding)
+    {
+        sliding_lt.init(N, window_pieces());
+        sliding_rt.init(N, window_pieces());
+    }
+    flush();
+}
+
+void DPL2FSDecoder::set_sliding_analysis(const bool v)
+{
+    sliding = v;
+    set_hop(hop, span);
+}
+
+void DPL2FSDecoder::set_block_switching(const unsigned int size, const float threshold)
+{
+    if (!initialized)
+        return;
+    transient_level = pow(10.0, threshold / 10.0);
+    if (size < 2 || size >= N || N % size != 0 || size % 2 != 0)
+    {
+        short_decoder.reset();
+        last_power.clear();
+        return;
+    }
+    if (!short_decoder)
+    {
+        short_decoder = std::make_unique<DPL2FSDecoder>();
+        short_decoder->Init(setup, size, samplerate);
+        if (reserved_blocksize > 0)
+            short_decoder->reserve(reserved_blocksize / 2);
+    }
+    else if (short_decoder->N != size)
+        short_decoder->reconfigure(setup, size, samplerate);
+    reset_block_switching();
+}
+
+void DPL2FSDecoder::reset_block_switching()
+{
+    // sqrt-Hann at half overlap, scaled so that the short blocks reproduce
+    // the long one as its own N-point transforms would
+    const unsigned int size = short_decoder->N;
+    short_window.resize(size);
+    for (unsigned int k = 0; k < size; k++)
+        short_window[k] = sqrt(0.5 * (1 - cos(2 * pi * k / size)) * N / size);
+    last_power.assign(N / 2 + 1, 0);
+    size_block_switching();
+}
+
+void DPL2FSDecoder::size_block_switching()
+{
+    short_out.resize(N * C);
+    short_audible.resize(C);
+}
+
+void DPL2FSDecoder::set_parallel(parallel_executor run, const unsigned int tasks, const unsigned int min_blocksize)
+{
+    if (!initialized)
+        return;
+    executor = tasks > 1 ? std::move(run) : nullptr;
+    parallel_min = min_blocksize;
+    lanes.resize(executor ? tasks : 0);
+    size_parallel();
+}
+
+void DPL2FSDecoder::set_parallel(const unsigned int threads, const unsigned int min_blocksize)
+{
+    if (threads < 2)
+    {
+        set_parallel(nullptr, 0, min_blocksize);
+        return;
+    }
+    auto pool = std::make_shared<TaskPool>(threads);
+    set_parallel([pool](const unsigned int count, const TaskPool::task &task) { pool->run(count, task); }, threads,
+                 min_blocksize);
+}
+
+void DPL2FSDecoder::size_parallel()
+{
+    if (lanes.empty())
+        return;
+    parallel_forward = fft_setup(N, false, parallel_forward_memory);
+    for (parallel_lane &lane : lanes)
+    {
+        lane.level.assign(C, 0);
+        lane.audible.assign(C, false);
+        lane.inverse = fft_setup(N, true, lane.inverse_memory);
+        lane.dst.assign(N, 0);
+    }
+}
+
+bool DPL2FSDecoder::parallel_block() const { return executor && N >= parallel_min; }
+
+void DPL2FSDecoder::set_channel_mask(const unsigned int mask)
+{
+    channel_mask = mask;
+    const std::vector<channel_id> &ids = chn_id.at(to_uint(setup));
+    active.resize(ids.size());
+    for (unsigned int c = 0; c < ids.size(); c++)
+        active[c] = (mask & to_uint(ids[c])) != 0;
+}
+
+void DPL2FSDecoder::set_output_format(const sample_format format, const channel_order order, const bool dither)
+{
+    out_format = format;
+    out_order = order;
+    out_dither = dither;
+    // rank the channels of the setup by their position in the requested order;
+    // channels that the order does not know about go last, in native order
+    const std::vector<channel_id> &ids = chn_id.at(to_uint(setup));
+    const std::vector<channel_id> &ranking = chn_order.at(std::to_underlying(order));
+    auto rank = [&](const unsigned int c)
+    {
+        const auto r = std::ranges::find(ranking, ids[c]);
+        return r == ranking.end() ? ranking.size() + c : static_cast<std::size_t>(r - ranking.begin());
+    };
+    // the ranks are distinct: each channel's slot is the number of channels
+    // ranked before it (no sorting, so that nothing is allocated)
+    out_slot.resize(ids.size());
+    for (unsigned int c = 0; c < ids.size(); c++)
+    {
+        out_slot[c] = 0;
+        for (unsigned int d = 0; d < ids.size(); d++)
+            out_slot[c] += rank(d) < rank(c);
+    }
+}
+
 // helper functions
 inline float DPL2FSDecoder::sqr(const double x) { return static_cast<float>(x * x); }
 
@@ -140,6 +730,48 @@ inline float DPL2FSDecoder::clamp(const double x) { return max(-1, min(1, x)); }
 
 inline float DPL2FSDecoder::sign(const double x) { return (x > 0) - (x < 0); }
 
+inline float DPL2FSDecoder::to_float(const float x) { return x; }
+
+inline float DPL2FSDecoder::to_float(const std::int16_t x) { return static_cast<float>(x) * (1.0f / 32768); }
+
+inline float DPL2FSDecoder::to_float(const pcm24 x)
+{
+    // assemble the sample in the upper 24 bits so that the sign is extended
+    const auto v = static_cast<std::int32_t>(static_cast<std::uint32_t>(x.bytes[0]) << 8 |
+                                             static_cast<std::uint32_t>(x.bytes[1]) << 16 |
+                                             static_cast<std::uint32_t>(x.bytes[2]) << 24);
+    return static_cast<float>(v) * (1.0f / 2147483648.0f);
+}
+
+inline float DPL2FSDecoder::to_float(const std::int32_t x) { return static_cast<float>(x) * (1.0f / 2147483648.0f); }
+
+inline void DPL2FSDecoder::to_sample(const float x, float &y, float) { y = x; }
+
+inline void DPL2FSDecoder::to_sample(const float x, std::int16_t &y, const float noise)
+{
+    const float v = std::nearbyint(x * 32768.0f + noise);
+    y = static_cast<std::int16_t>(v < -32768.0f ? -32768.0f : v > 32767.0f ? 32767.0f : v);
+}
+
+inline void DPL2FSDecoder::to_sample(const float x, pcm24 &y, const float noise)
+{
+    const float v = std::nearbyint(x * 8388608.0f + noise);
+    const auto i = static_cast<std::int32_t>(v < -8388608.0f ? -8388608.0f : v > 8388607.0f ? 8388607.0f : v);
+    y.bytes[0] = static_cast<std::uint8_t>(i);
+    y.bytes[1] = static_cast<std::uint8_t>(i >> 8);
+    y.bytes[2] = static_cast<std::uint8_t>(i >> 16);
+}
+
+// triangular dither noise: the difference of two uniform variates
+inline float DPL2FSDecoder::tpdf()
+{
+    dither_state = dither_state * 1664525 + 1013904223;
+    const float a = static_cast<float>(dither_state >> 8) * (1.0f / 16777216);
+    dither_state = dither_state * 1664525 + 1013904223;
+    const float b = static_cast<float>(dither_state >> 8) * (1.0f / 16777216);
+    return a - b;
+}
+
 // get the distance of the soundfield edge, along a given angle
 inline double DPL2FSDecoder::edgedistance(const double a)
 {
@@ -156,96 +788,804 @@ int DPL2FSDecoder::map_to_grid(double &x)
     return static_cast<int>(i);
 }
 
-// decode a block of data and overlap-add it into outbuf
-void DPL2FSDecoder::buffered_decode(const float *input)
+// demultiplex, convert and window a block of stereo data
+template <typename Sample>
+double DPL2FSDecoder::window_block(const float *history, const unsigned int head, const Sample *input)
 {
-    // demultiplex and apply window function
-    for (unsigned int k = 0; k < N; k++)
+    for (unsigned int k = 0; k < head; k++)
+    {
+        lt[k] = wnd[k] * history[k * 2 + 0];
+        rt[k] = wnd[k] * history[k * 2 + 1];
+    }
+    double energy = 0;
+    for (unsigned int k = head; k < N; k++)
     {
-        lt[k] = wnd[k] * input[k * 2 + 0];
-        rt[k] = wnd[k] * input[k * 2 + 1];
+        const double l = to_float(input[(k - head) * 2 + 0]);
+        const double r = to_float(input[(k - head) * 2 + 1]);
+        lt[k] = wnd[k] * l;
+        rt[k] = wnd[k] * r;
+        if (k < N - hop)
+            continue;
+        energy += l * l + r * r;
+        fresh[(k - (N - hop)) * 2 + 0] = l;
+        fresh[(k - (N - hop)) * 2 + 1] = r;
     }
+    // the history never reaches into the last hop of the block
+    return energy;
+}
 
+// update the silence gate with the energy of the newest half-block
+bool DPL2FSDecoder::silent_block(const double energy)
+{
+    // the block is silent once all of its hops are
+    silent_hops = energy <= silence_level * (2 * hop) ? std::min(silent_hops + 1, N / hop) : 0;
+    const bool silent = silent_hops == N / hop;
+    stats.blocks++;
+    stats.silent_blocks += silent;
+    return silent;
+}
+
+// decode a block of data, overlap-add it and write out the completed half
+void DPL2FSDecoder::buffered_decode(void *output, const unsigned int frame, const bool formatted, const bool silent)
+{
+    if (!begin_block(output, frame, formatted, silent))
+        return;
+    // compute the multichannel spectra and synthesize them
+    spectral_decode(&lf[0], &rf[0], true);
+    synthesize_block(&spectra[0], &scale[0], output, frame, formatted);
+}
+
+bool DPL2FSDecoder::begin_block(void *output, const unsigned int frame, const bool formatted, const bool silent)
+{
     // map into spectral domain
-    kiss_fftr(forward, &lt[0], std::bit_cast<kiss_fft_cpx *>(&lf[0]));
-    kiss_fftr(forward, &rt[0], std::bit_cast<kiss_fft_cpx *>(&rf[0]));
+    transform_block(silent);
+    // a silent block only drains what is left of the previous one
+    if (silent)
+    {
+        std::ranges::fill(last_power, 0.0);
+        synthesize_block(&no_spectra[0], nullptr, output, frame, formatted);
+        return false;
+    }
+    // a transient block is decoded as a series of short blocks
+    if (short_decoder && transient_block())
+    {
+        short_decode();
+        for (unsigned int c = 0; c < C; c++)
+            write_block(c, short_audible[c] ? &short_out[c * N] : nullptr, 1, output, frame, formatted);
+        stats.short_blocks++;
+        return false;
+    }
+    return true;
+}
 
-    // compute multichannel output signal in the spectral domain
-    for (unsigned int f = 1; f < N / 2; f++)
+// compute the multichannel spectra from the Lt/Rt spectra
+void DPL2FSDecoder::spectral_decode(const cplx *lf, const cplx *rf, const bool shared)
+{
+    if (!begin_spectral_decode(lf, rf, shared))
+        return;
+    if (parallel_block())
+        parallel_steer(lf, rf);
+    else
+        for (unsigned int f = first_bin; f < last_bin; f++)
+            steer_bin(f, lf, rf, level, audible, stats.sparse_bins);
+    end_spectral_decode();
+}
+
+bool DPL2FSDecoder::begin_spectral_decode(const cplx *lf, const cplx *rf, const bool shared)
+{
+    update_steering();
+    std::fill(audible.begin(), audible.end(), false);
+    std::ranges::fill(scale, 1.0);
+    if (correlation_shortcut && correlated_decode(lf, rf, shared))
+    {
+        stats.correlated_blocks++;
+        return false;
+    }
+
+    // compute multichannel output signal in the spectral domain; channels
+    // that are masked off or end up with an all-zero spectrum stay inaudible
+    // and are not back-transformed
+    const alloc_lut &alloc = *setup_alloc;
+
+    update_bass_weight();
+
+    // steer each perceptual band as a whole
+    if (band_resolution > 0)
     {
-        // get Lt/Rt amplitudes & phases
-        const double ampL = amplitude(lf[f]);
-        const double ampR = amplitude(rf[f]);
-        const double phaseL = phase(lf[f]);
-        const double phaseR = phase(rf[f]);
-        // calculate the amplitude & phase differences
-        const double ampDiff = clamp(ampL + ampR < epsilon ? 0 : (ampR - ampL) / (ampR + ampL));
-        double phaseDiff = abs(phaseL - phaseR);
-        if (phaseDiff > pi)
-            phaseDiff = 2 * pi - phaseDiff;
-
-        // decode into x/y soundfield position
-        auto [x, y] = transform_decode(ampDiff, phaseDiff);
-        // add wrap control
-        transform_circular_wrap(x, y, circular_wrap);
-        // add shift control
-        y = clamp(y - shift);
-        // add depth control
-        y = clamp(1 - (1 - y) * depth);
-        // add focus control
-        transform_focus(x, y, focus);
-        // add crossfeed control
-        x = clamp(x * (front_separation * (1 + y) / 2 + rear_separation * (1 - y) / 2));
-
-        // get total signal amplitude
-        const double amp_total = sqrt(ampL * ampL + ampR * ampR);
-        // and total L/C/R signal phases
-        const std::array phase_of = {phaseL, atan2(lf[f].imag() + rf[f].imag(), lf[f].real() + rf[f].real()), phaseR};
-        // compute 2d channel map indexes p/q and update x/y to fractional offsets
-        // in the map grid
+        update_bands();
+        for (unsigned int b = 0; b + 1 < band_edge.size(); b++)
+        {
+            double ll = 0;
+            double rr = 0;
+            cplx lr = 0;
+            for (unsigned int f = band_edge[b]; f < band_edge[b + 1]; f++)
+            {
+                ll += std::norm(lf[f]);
+                rr += std::norm(rf[f]);
+                lr += lf[f] * std::conj(rf[f]);
+            }
+            position_levels(sqrt(ll), sqrt(rr), abs(std::arg(lr)), level);
+            std::ranges::copy(level, band_level.begin() + b * C);
+        }
+    }
+
+    // bins outside the processing range and bins this far below the loudest
+    // one are not worth steering: they get the channel gains of the center
+    // position, computed once per block
+    const bool sparse = sparse_level > 0;
+    if (sparse || first_bin > 1 || last_bin < N / 2)
+    {
+        auto [x, y] = steer(0, 0);
         const int p = map_to_grid(x);
         const int q = map_to_grid(y);
-        // map position to channel volumes
         for (unsigned int c = 0; c < C - 1; c++)
+            center_gain[c] = active[c] ? bilinear(alloc[c], p, q, x, y) : 0;
+    }
+    for (unsigned int f = 1; f < first_bin; f++)
+        sparse_bin(f, lf[f] + rf[f], sqrt(std::norm(lf[f]) + std::norm(rf[f])), audible);
+    for (unsigned int f = last_bin; f < N / 2; f++)
+        sparse_bin(f, lf[f] + rf[f], sqrt(std::norm(lf[f]) + std::norm(rf[f])), audible);
+    sparse_limit = 0;
+    if (sparse)
+    {
+        double peak = 0;
+        for (unsigned int f = first_bin; f < last_bin; f++)
         {
-            // look up channel map at respective position (with bilinear
-            // interpolation) and build the
-            // signal
-            std::vector<float *> a = chn_alloc.at(to_uint(setup))[c];
-            signal[c][f] = polar(amp_total *
-                                     ((1 - x) * (1 - y) * a[q][p] + x * (1 - y) * a[q][p + 1] +
-                                      (1 - x) * y * a[q + 1][p] + x * y * a[q + 1][p + 1]),
-                                 phase_of[1 + sign(chn_xsf.at(to_uint(setup))[c])]);
+            bin_power[f] = std::norm(lf[f]) + std::norm(rf[f]);
+            peak = std::max(peak, bin_power[f]);
         }
+        sparse_limit = sparse_level * peak;
+    }
+    stats.bins += last_bin - first_bin;
+    return true;
+}
+
+// steer bin f in the processing range
+void DPL2FSDecoder::steer_bin(const unsigned int f, const cplx *lf, const cplx *rf, std::vector<double> &levels,
+                              std::vector<bool> &heard, unsigned long long &sparse)
+{
+    if (bin_power[f] < sparse_limit)
+    {
+        sparse++;
+        sparse_bin(f, lf[f] + rf[f], sqrt(bin_power[f]), heard);
+        return;
+    }
+
+    const std::vector<float> &xsf = *setup_xsf;
+    // get Lt/Rt amplitudes & phases
+    const double ampL = amplitude(lf[f]);
+    const double ampR = amplitude(rf[f]);
+    const double phaseL = phase(lf[f]);
+    const double phaseR = phase(rf[f]);
+    // get the channel levels at the bin's soundfield position, or those of
+    // its band
+    if (band_resolution > 0)
+        band_levels(f, levels);
+    else
+        position_levels(ampL, ampR, abs(phaseL - phaseR), levels);
 
-        // optionally redirect bass
-        if (!use_lfe)
+    // get total signal amplitude
+    const double amp_total = sqrt(ampL * ampL + ampR * ampR);
+    // and total L/C/R signal phases
+    const std::array phase_of = {phaseL, atan2(lf[f].imag() + rf[f].imag(), lf[f].real() + rf[f].real()), phaseR};
+    // map position to channel volumes
+    for (unsigned int c = 0; c < C - 1; c++)
+    {
+        if (!active[c])
             continue;
-        const auto w = static_cast<float>(f);
-        if (w >= hi_cut)
+        // build the signal
+        const double gain = amp_total * levels[c];
+        if (gain == 0)
+        {
+            signal[c][f] = 0;
             continue;
-        // level of LFE channel according to normalized frequency
-        double lfe_level = w < lo_cut ? 1 : 0.5 * (1 + cos(pi * (w - lo_cut) / (hi_cut - lo_cut)));
-        // assign LFE channel
-        signal[C - 1][f] = lfe_level * polar(amp_total, phase_of[1]);
-        // subtract the signal from the other channels
-        for (unsigned int c = 0; c < C - 1; c++)
-            signal[c][f] *= 1 - lfe_level;
+        }
+        signal[c][f] = polar(gain, phase_of[1 + sign(xsf[c])]);
+        heard[c] = true;
+    }
+
+    // optionally redirect bass (the phasor is only worth computing for the
+    // bins that go to the LFE channel)
+    if (use_lfe && f < bass_weight.size())
+        redirect_bass(f, polar(amp_total, phase_of[1]), heard);
+}
+
+// each lane starts out with no audible channels and no sparse bins, and
+// adds its own to those of the block afterwards
+void DPL2FSDecoder::parallel_steer(const cplx *lf, const cplx *rf)
+{
+    const std::array inputs = {lf, rf};
+    executor(static_cast<unsigned int>(lanes.size()),
+             [this, &inputs](const unsigned int t)
+             {
+                 const DenormalScope ftz;
+                 parallel_lane &lane = lanes[t];
+                 std::fill(lane.audible.begin(), lane.audible.end(), false);
+                 lane.sparse_bins = 0;
+                 const auto count = static_cast<unsigned int>(lanes.size());
+                 const unsigned int bins = last_bin - first_bin;
+                 for (unsigned int f = first_bin + bins * t / count; f < first_bin + bins * (t + 1) / count; f++)
+                     steer_bin(f, inputs[0], inputs[1], lane.level, lane.audible, lane.sparse_bins);
+             });
+    for (const parallel_lane &lane : lanes)
+    {
+        for (unsigned int c = 0; c < C; c++)
+            audible[c] = audible[c] || lane.audible[c];
+        stats.sparse_bins += lane.sparse_bins;
+    }
+}
+
+void DPL2FSDecoder::end_spectral_decode()
+{
+    for (unsigned int c = 0; c < C; c++)
+        spectra[c] = audible[c] ? &signal[c][0] : nullptr;
+}
+
+// get the channel levels in level for the soundfield position of the given
+// Lt/Rt amplitudes and phase difference
+void DPL2FSDecoder::position_levels(const double ampL, const double ampR, double phaseDiff,
+                                    std::vector<double> &levels)
+{
+    const alloc_lut &alloc = *setup_alloc;
+    // calculate the amplitude & phase differences
+    const double ampDiff = clamp(ampL + ampR < epsilon ? 0 : (ampR - ampL) / (ampR + ampL));
+    if (phaseDiff > pi)
+        phaseDiff = 2 * pi - phaseDiff;
+
+    // decode into x/y soundfield position
+    auto [x, y] = steer(ampDiff, phaseDiff);
+    // compute 2d channel map indexes p/q and update x/y to fractional offsets
+    // in the map grid
+    const int p = map_to_grid(x);
+    const int q = map_to_grid(y);
+    // look up channel map at respective position (with bilinear interpolation)
+    for (unsigned int c = 0; c < C - 1; c++)
+        levels[c] = active[c] ? bilinear(alloc[c], p, q, x, y) : 0;
+}
+
+// get the channel levels in level for bin f, interpolated between the levels
+// of the bands whose centers surround it
+void DPL2FSDecoder::band_levels(const unsigned int f, std::vector<double> &levels)
+{
+    const unsigned int b = bin_band[f];
+    const unsigned int next = std::min<unsigned int>(b + 1, band_edge.size() - 2);
+    const double t = bin_offset[f];
+    for (unsigned int c = 0; c < C - 1; c++)
+        levels[c] = (1 - t) * band_level[b * C + c] + t * band_level[next * C + c];
+}
+
+// hand the snapshot over through the triple buffer: fill the own slot and
+// swap it with the middle one, which the audio side swaps with its own
+void DPL2FSDecoder::publish_steering()
+{
+    snapshot[control_slot] = control;
+    control_slot = middle_slot.exchange(control_slot | fresh_snapshot, std::memory_order_acq_rel) & slot_mask;
+}
+
+void DPL2FSDecoder::update_steering()
+{
+    if (middle_slot.load(std::memory_order_relaxed) & fresh_snapshot)
+    {
+        audio_slot = middle_slot.exchange(audio_slot, std::memory_order_acq_rel) & slot_mask;
+        steering_target = snapshot[audio_slot];
+        glide_left = glide_blocks;
+    }
+    if (glide_left == 0)
+    {
+        steering = steering_target;
+        return;
+    }
+    // cover an equal share of the remaining way in each block
+    const float share = 1.0f / static_cast<float>(glide_left--);
+    for (float steering_parameters::*p : steering_fields)
+        steering.*p += share * (steering_target.*p - steering.*p);
+}
+
+// split the processing range into bands of band_resolution ERB each
+void DPL2FSDecoder::update_bands()
+{
+    if (!bands_stale)
+        return;
+    // ERB-rate scale (Glasberg & Moore)
+    const auto erb_rate = [this](const unsigned int f)
+    { return 21.4 * log10(1 + 0.00437 * f * samplerate / N); };
+    band_edge.assign(1, first_bin);
+    for (unsigned int f = first_bin + 1; f < last_bin; f++)
+        if (erb_rate(f) - erb_rate(band_edge.back()) >= band_resolution)
+            band_edge.push_back(f);
+    band_edge.push_back(last_bin);
+    band_level.resize((band_edge.size() - 1) * C);
+
+    // for each bin, the band whose center is at or below it and the
+    // fractional offset towards the next band center
+    unsigned int b = 0;
+    const auto center = [this](const unsigned int b) { return (band_edge[b] + band_edge[b + 1] - 1) / 2.0; };
+    for (unsigned int f = first_bin; f < last_bin; f++)
+    {
+        while (b + 2 < band_edge.size() && center(b + 1) <= f)
+            b++;
+        bin_band[f] = b;
+        bin_offset[f] =
+            b + 2 < band_edge.size() && f > center(b) ? (f - center(b)) / (center(b + 1) - center(b)) : 0;
+    }
+    bands_stale = false;
+}
+
+// place bin f in the center at the given total amplitude, in the phase of
+// the sum Lt+Rt
+void DPL2FSDecoder::sparse_bin(const unsigned int f, const cplx sum, const double amp_total, std::vector<bool> &heard)
+{
+    const double amp_sum = abs(sum);
+    const cplx center = amp_sum > 0 ? sum * (amp_total / amp_sum) : cplx(0);
+    for (unsigned int c = 0; c < C - 1; c++)
+    {
+        signal[c][f] = center_gain[c] * center;
+        heard[c] = heard[c] || signal[c][f] != cplx(0);
+    }
+    redirect_bass(f, center, heard);
+}
+
+// move the bass of bin f, whose total signal is center, from the other
+// channels to the LFE channel (if enabled)
+void DPL2FSDecoder::redirect_bass(const unsigned int f, const cplx center, std::vector<bool> &heard)
+{
+    if (!use_lfe || f >= bass_weight.size())
+        return;
+    // level of LFE channel according to normalized frequency
+    const double lfe_level = bass_weight[f];
+    // assign LFE channel
+    if (active[C - 1])
+    {
+        signal[C - 1][f] = lfe_level * center;
+        heard[C - 1] = heard[C - 1] || lfe_level * center != cplx(0);
+    }
+    // subtract the signal from the other channels
+    for (unsigned int c = 0; c < C - 1; c++)
+        signal[c][f] *= 1 - lfe_level;
+}
+
+// decode a block whose Lt is a real multiple g of its Rt
+bool DPL2FSDecoder::correlated_decode(const cplx *lf, const cplx *rf, const bool shared)
+{
+    // Lt = g*Rt exactly when the Cauchy-Schwarz inequality |<Lt,Rt>|^2 <=
+    // |Lt|^2 |Rt|^2 holds with equality and <Lt,Rt> is real
+    constexpr double tolerance = 1e-9;
+    double ll = 0;
+    double rr = 0;
+    cplx lr = 0;
+    for (unsigned int f = 1; f < N / 2; f++)
+    {
+        ll += std::norm(lf[f]);
+        rr += std::norm(rf[f]);
+        lr += lf[f] * std::conj(rf[f]);
+    }
+    if (rr == 0 || std::norm(lr) < (1 - tolerance) * ll * rr || sqr(lr.imag()) > tolerance * std::norm(lr))
+        return false;
+    const double g = lr.real() / rr;
+    // the phase of Lt+Rt is ill-defined when the two nearly cancel out
+    if (abs(1 + g) < 0.001)
+        return false;
+
+    // every bin decodes to the same position (amplitude ratio |g|, phases equal
+    // or opposite), so the channel gains are computed once
+    auto [x, y] = steer(clamp((1 - abs(g)) / (1 + abs(g))), g < 0 ? pi : 0);
+    const int p = map_to_grid(x);
+    const int q = map_to_grid(y);
+    // every channel is a real multiple of Rt: its amplitude is the total
+    // amplitude |Rt| sqrt(1+g^2), and its phase that of Lt = g*Rt, Lt+Rt =
+    // (1+g)*Rt or Rt, i.e., the one of Rt, flipped where the factor is negative
+    const alloc_lut &alloc = *setup_alloc;
+    const std::vector<float> &xsf = *setup_xsf;
+    const double amp = sqrt(1 + g * g);
+    const std::array factor_of = {g, 1 + g, 1.0};
+    for (unsigned int c = 0; c < C - 1; c++)
+    {
+        scale[c] = active[c] ? amp * bilinear(alloc[c], p, q, x, y) * sign(factor_of[1 + sign(xsf[c])]) : 0;
+        audible[c] = scale[c] != 0;
     }
 
-    // shift the last 2/3 to the first 2/3 of the output buffer
-    memcpy(&outbuf[0], &outbuf[C * N / 2], N * C * 4);
-    // and clear the rest
-    memset(&outbuf[C * N], 0, C * 4 * N / 2);
-    // backtransform each channel and overlap-add
+    // the shared spectrum is Rt, less the bass that goes to the LFE channel
+    update_bass_weight();
+    for (unsigned int f = 1; f < N / 2; f++)
+    {
+        basis[f] = rf[f];
+        if (!use_lfe || f >= bass_weight.size())
+            continue;
+        const double lfe_level = bass_weight[f];
+        if (active[C - 1])
+            signal[C - 1][f] = lfe_level * amp * sign(1 + g) * rf[f];
+        basis[f] *= 1 - lfe_level;
+    }
+    audible[C - 1] = use_lfe && active[C - 1];
+
+    for (unsigned int c = 0; c < C - 1; c++)
+    {
+        if (!audible[c] || shared)
+            continue;
+        // materialize the channel spectrum
+        for (unsigned int f = 1; f < N / 2; f++)
+            signal[c][f] = scale[c] * basis[f];
+        scale[c] = 1;
+    }
     for (unsigned int c = 0; c < C; c++)
+        spectra[c] = !audible[c] ? nullptr : c < C - 1 && shared ? &basis[0] : &signal[c][0];
+    return true;
+}
+
+// back-transform a set of spectra, overlap-add them and write out the
+// completed half
+void DPL2FSDecoder::synthesize_block(const cplx *const *spectra, const double *scales, void *output,
+                                     const unsigned int frame, const bool formatted)
+{
+    // backtransform the channels first, first+step, ... with the given
+    // transform into out and overlap-add them
+    const auto channels = [&](const unsigned int first, const unsigned int step, const kiss_fftr_cfg fft, double *out)
+    {
+        const cplx *transformed = nullptr;
+        for (unsigned int c = first; c < C; c += step)
+        {
+            // back-transform into time domain (once for channels that share
+            // their spectrum)
+            const bool silent = spectra[c] == nullptr;
+            if (!silent && spectra[c] != transformed)
+            {
+                // the decoder's own LFE spectrum only has bins below hi_cut
+                if (spectra[c] == &signal[C - 1][0] && lfe_inverse)
+                    synthesize_lfe(spectra[c], out);
+                else
+                    kiss_fftri(fft, std::bit_cast<const kiss_fft_cpx *>(spectra[c]), out);
+                transformed = spectra[c];
+            }
+            write_block(c, silent ? nullptr : out, scales ? scales[c] : 1, output, frame, formatted);
+        }
+    };
+    // the dither noise is drawn in channel order, so dithered output is
+    // synthesized serially; so are channels that share a spectrum (as in
+    // correlated blocks), which takes a single back-transform that the lanes
+    // would each repeat
+    bool shared = false;
+    for (unsigned int c = 1; c < C; c++)
+        shared = shared || (spectra[c] && std::find(spectra, spectra + c, spectra[c]) != spectra + c);
+    if (!parallel_block() || (formatted && out_dither) || shared)
+    {
+        channels(0, 1, inverse, &dst[0]);
+        return;
+    }
+    executor(std::min(static_cast<unsigned int>(lanes.size()), C),
+             [this, &channels](const unsigned int t)
+             {
+                 const DenormalScope ftz;
+                 const unsigned int step = std::min(static_cast<unsigned int>(lanes.size()), C);
+                 channels(t, step, lanes[t].inverse, &lanes[t].dst[0]);
+             });
+}
+
+// add a back-transformed block to the tail, windowed, and write out the
+// completed hop (remultiplexed)
+void DPL2FSDecoder::write_block(const unsigned int c, const double *block, const double gain, void *output,
+                                const unsigned int frame, const bool formatted)
+{
+    const sample_format format = formatted ? out_format : sample_format::sf_float;
+    const bool dither = formatted && out_dither;
+    const unsigned int offset = C * frame + (formatted ? out_slot[c] : native_slot[c]);
+    switch (format)
+    {
+        case sample_format::sf_int16:
+            overlap_add(c, block, static_cast<std::int16_t *>(output) + offset, gain, dither);
+            break;
+        case sample_format::sf_int24:
+            overlap_add(c, block, static_cast<pcm24 *>(output) + offset, gain, dither);
+            break;
+        default:
+            overlap_add(c, block, static_cast<float *>(output) + offset, gain, false);
+    }
+}
+
+// overlap-add a back-transformed channel and write the completed half-block
+template <typename Sample>
+void DPL2FSDecoder::overlap_add(const unsigned int c, const double *block, Sample *output, const double gain,
+                                const bool dither)
+{
+    const unsigned int overlap = span - hop;
+    float *t = &tail[c * overlap];
+    if (!block)
+    {
+        // nothing to add, just drain the tail
+        for (unsigned int k = 0; k < hop; k++)
+            to_sample(t[k], output[C * k], dither ? tpdf() : 0);
+        std::copy(t + hop, t + overlap, t);
+        std::fill(t + overlap - hop, t + overlap, 0.0f);
+        return;
+    }
+    // only the last span samples of the block are synthesized
+    const double *y = block + (N - span);
+    if (dither)
+        for (unsigned int k = 0; k < hop; k++)
+            to_sample(t[k] + static_cast<float>(gain * swnd[k] * y[k]), output[C * k], tpdf());
+    else
+        for (unsigned int k = 0; k < hop; k++)
+            to_sample(t[k] + static_cast<float>(gain * swnd[k] * y[k]), output[C * k], 0);
+    for (unsigned int k = hop; k < overlap; k++)
+        t[k - hop] = flush_denormal(t[k] + static_cast<float>(gain * swnd[k] * y[k]));
+    for (unsigned int k = overlap; k < span; k++)
+        t[k - hop] = flush_denormal(static_cast<float>(gain * swnd[k] * y[k]));
+}
+
+// map amp/phase differences to a soundfield position, with all soundfield
+// controls applied
+std::tuple<double, double> DPL2FSDecoder::steer(const double ampDiff, const double phaseDiff) const
+{
+    // decode into x/y soundfield position
+    auto [x, y] = transform_decode(ampDiff, phaseDiff);
+    // add wrap control
+    transform_circular_wrap(x, y, steering.circular_wrap);
+    // add shift control
+    y = clamp(y - steering.shift);
+    // add depth control
+    y = clamp(1 - (1 - y) * steering.depth);
+    // add focus control
+    transform_focus(x, y, steering.focus);
+    // add crossfeed control
+    x = clamp(x * (steering.front_separation * (1 + y) / 2 + steering.rear_separation * (1 - y) / 2));
+    return std::make_tuple(x, y);
+}
+
+// look up a channel map at a grid position, with bilinear interpolation
+inline double DPL2FSDecoder::bilinear(const std::vector<float *> &a, const int p, const int q, const double x,
+                                      const double y)
+{
+    return (1 - x) * (1 - y) * a[q][p] + x * (1 - y) * a[q][p + 1] + (1 - x) * y * a[q + 1][p] +
+        x * y * a[q + 1][p + 1];
+}
+
+// level of the LFE channel at a given bin below the high cutoff
+inline double DPL2FSDecoder::bass_level(const float w) const
+{
+    return w < lo_cut ? 1 : 0.5 * (1 + cos(pi * (w - lo_cut) / (hi_cut - lo_cut)));
+}
+
+void DPL2FSDecoder::make_windows()
+{
+    // periodic Hann window of length l at k
+    const auto hann = [](const unsigned int k, const unsigned int l) { return 0.5 * (1 - cos(2 * pi * k / l)); };
+    wnd.resize(N);
+    swnd.resize(span);
+    if (span == N)
     {
-        // back-transform into time domain
-        kiss_fftri(inverse, std::bit_cast<kiss_fft_cpx *>(&signal[c][0]), &dst[0]);
-        // add the result to the last 2/3 of the output buffer, windowed (and
-        // remultiplex)
+        // sqrt-Hann for both analysis and synthesis; the squared windows
+        // overlap-add to N/(2*hop), which the scale makes up for
         for (unsigned int k = 0; k < N; k++)
-            outbuf[C * (k + N / 2) + c] += static_cast<float>(wnd[k] * dst[k]);
+            wnd[k] = sqrt(0.5 * (1 - cos(2 * pi * k / N)) / N * (2.0 * hop / N));
+        swnd = wnd;
+        return;
+    }
+    // asymmetric windows (after Mauler & Martin): the analysis window rises
+    // over all but the last hop and falls over that one as a sqrt-Hann of
+    // length span does; the synthesis window makes the product of both a
+    // Hann window of length span, which overlap-adds to one at this hop
+    const unsigned int rise = N - hop;
+    for (unsigned int k = 0; k < rise; k++)
+        wnd[k] = sqrt(hann(k, 2 * rise) / N);
+    for (unsigned int k = rise; k < N; k++)
+        wnd[k] = sqrt(hann(k - (N - span), span) / N);
+    for (unsigned int k = 0; k < span; k++)
+    {
+        const double a = wnd[N - span + k];
+        swnd[k] = a > 0 ? hann(k, span) / N / a : 0;
+    }
+}
+
+// the windows of make_windows(): sqrt(hann(k, l)) is sin(pi*k/l)
+std::vector<SlidingDFT::piece> DPL2FSDecoder::window_pieces() const
+{
+    if (span == N)
+        return {{0, N, 2 * N, 0, sqrt(2.0 * hop / N / N)}};
+    const unsigned int rise = N - hop;
+    return {{0, rise, 4 * rise, 0, 1 / sqrt(N)}, {rise, N, 2 * span, N - span, 1 / sqrt(N)}};
+}
+
+void DPL2FSDecoder::transform_block(const bool silent)
+{
+    if (sliding && !silent && parallel_block())
+        executor(2,
+                 [this](const unsigned int t)
+                 {
+                     const DenormalScope ftz;
+                     (t == 0 ? sliding_lt : sliding_rt).advance(&fresh[t], 2, hop, t == 0 ? &lf[0] : &rf[0]);
+                 });
+    else if (sliding)
+    {
+        sliding_lt.advance(&fresh[0], 2, hop, silent ? nullptr : &lf[0]);
+        sliding_rt.advance(&fresh[1], 2, hop, silent ? nullptr : &rf[0]);
+    }
+    else if (!silent && parallel_block())
+        executor(2,
+                 [this](const unsigned int t)
+                 {
+                     const DenormalScope ftz;
+                     if (t == 0)
+                         kiss_fftr(forward, &lt[0], std::bit_cast<kiss_fft_cpx *>(&lf[0]));
+                     else
+                         kiss_fftr(parallel_forward, &rt[0], std::bit_cast<kiss_fft_cpx *>(&rf[0]));
+                 });
+    else if (!silent)
+    {
+        kiss_fftr(forward, &lt[0], std::bit_cast<kiss_fft_cpx *>(&lf[0]));
+        kiss_fftr(forward, &rt[0], std::bit_cast<kiss_fft_cpx *>(&rf[0]));
+    }
+}
+
+void DPL2FSDecoder::update_bass_weight()
+{
+    if (!bass_weight_stale)
+        return;
+    bass_weight.clear();
+    for (unsigned int f = 0; f < N / 2 && static_cast<float>(f) < hi_cut; f++)
+        bass_weight.push_back(bass_level(static_cast<float>(f)));
+    // clear LFE bins left over from a higher cutoff
+    std::fill(signal[C - 1].begin() + bass_weight.size(), signal[C - 1].end(), cplx(0));
+    bass_weight_stale = false;
+
+    // the LFE transform: the smallest even divisor M of N that holds the LFE
+    // bins (with some headroom, as tiny transforms are dominated by overhead)
+    const auto bins = static_cast<unsigned int>(bass_weight.size());
+    unsigned int size = std::max(2 * bins + 2, 32u);
+    while (size < N && (N % size != 0 || size % 2 != 0))
+        size++;
+    lfe_inverse = nullptr;
+    if (size >= N)
+        return;
+    lfe_inverse = fft_setup(size, true, lfe_memory);
+    lfe_spectrum.assign(size / 2 + 1, 0);
+    lfe_time.resize(size);
+    // phase shift of bin f for the samples at offset r from each M-point grid
+    const unsigned int stride = N / size;
+    lfe_twiddle.resize(stride * bins);
+    for (unsigned int r = 0; r < stride; r++)
+        for (unsigned int f = 0; f < bins; f++)
+            lfe_twiddle[r * bins + f] = std::polar(1.0, 2 * pi * f * r / N);
+}
+
+// back-transform the LFE spectrum into out; its bins are all below M/2, so
+// the samples r, r+N/M, r+2N/M, ... are the M-point inverse transform of
+// the spectrum shifted by r samples
+void DPL2FSDecoder::synthesize_lfe(const cplx *spectrum, double *out)
+{
+    const auto bins = static_cast<unsigned int>(bass_weight.size());
+    const auto size = static_cast<unsigned int>(lfe_time.size());
+    const unsigned int stride = N / size;
+    for (unsigned int r = 0; r < stride; r++)
+    {
+        for (unsigned int f = 0; f < bins; f++)
+            lfe_spectrum[f] = spectrum[f] * lfe_twiddle[r * bins + f];
+        kiss_fftri(lfe_inverse, std::bit_cast<const kiss_fft_cpx *>(&lfe_spectrum[0]), &lfe_time[0]);
+        for (unsigned int m = 0; m < size; m++)
+            out[m * stride + r] = lfe_time[m];
+    }
+}
+
+// the block is transient if the power that newly appeared in its bins
+// (spectral flux) is large against the total power of the previous block
+bool DPL2FSDecoder::transient_block()
+{
+    double rise = 0;
+    double total = 0;
+    for (unsigned int f = 0; f <= N / 2; f++)
+    {
+        const double p = std::norm(lf[f]) + std::norm(rf[f]);
+        rise += std::max(0.0, p - last_power[f]);
+        total += last_power[f];
+        last_power[f] = p;
+    }
+    return rise > transient_level * total;
+}
+
+// cut the windowed block into half-overlapping short blocks, decode each of
+// them and overlap-add the results; without steering, they add up to N
+// times the block, just as the long back-transform would
+void DPL2FSDecoder::short_decode()
+{
+    update_steering();
+    sync_short_decoder();
+    DPL2FSDecoder &d = *short_decoder;
+    const auto n = static_cast<int>(d.N);
+    const auto size = static_cast<int>(N);
+    std::ranges::fill(short_out, 0.0);
+    std::fill(short_audible.begin(), short_audible.end(), false);
+    // the short blocks' bins are too wide to tell the bass apart, so the LFE
+    // channel is taken from the long block
+    if (use_lfe)
+        split_bass();
+    // from the short block that straddles the start of the block on; only
+    // those that reach into the synthesized span are needed
+    for (int start = -n / 2; start < size; start += n / 2)
+    {
+        if (start + n <= size - static_cast<int>(span))
+            continue;
+        const int from = std::max(0, -start);
+        const int to = std::min(n, size - start);
+        std::ranges::fill(d.lt, 0.0);
+        std::ranges::fill(d.rt, 0.0);
+        for (int k = from; k < to; k++)
+        {
+            d.lt[k] = short_window[k] * lt[start + k];
+            d.rt[k] = short_window[k] * rt[start + k];
+        }
+        kiss_fftr(d.forward, &d.lt[0], std::bit_cast<kiss_fft_cpx *>(&d.lf[0]));
+        kiss_fftr(d.forward, &d.rt[0], std::bit_cast<kiss_fft_cpx *>(&d.rf[0]));
+        d.spectral_decode(&d.lf[0], &d.rf[0], false);
+        for (unsigned int c = 0; c < C; c++)
+        {
+            if (!d.spectra[c])
+                continue;
+            short_audible[c] = true;
+            kiss_fftri(d.inverse, std::bit_cast<const kiss_fft_cpx *>(d.spectra[c]), &d.dst[0]);
+            double *out = &short_out[c * N];
+            for (int k = from; k < to; k++)
+                out[start + k] += short_window[k] * d.dst[k];
+        }
+    }
+}
+
+// send the bass of the long block to the LFE channel, as steer_bin() would,
+// and take it out of the windowed block in lt/rt before it is cut up
+void DPL2FSDecoder::split_bass()
+{
+    update_bass_weight();
+    const auto bins = static_cast<unsigned int>(bass_weight.size());
+    cplx *bass = &signal[C - 1][0];
+    // back-transform the bins below the high cutoff in signal[C-1] into out
+    const auto back_transform = [&](double *out)
+    {
+        if (lfe_inverse)
+            synthesize_lfe(bass, out);
+        else
+            kiss_fftri(inverse, std::bit_cast<const kiss_fft_cpx *>(bass), out);
+    };
+    // the bass of Lt and of Rt, which the back-transform scales by N
+    for (const auto &[spectrum, block] : {std::pair{&lf[0], &lt[0]}, std::pair{&rf[0], &rt[0]}})
+    {
+        for (unsigned int f = 0; f < bins; f++)
+            bass[f] = f > 0 ? bass_weight[f] * spectrum[f] : 0;
+        back_transform(&dst[0]);
+        for (unsigned int k = 0; k < N; k++)
+            block[k] -= dst[k] / N;
+    }
+    if (!active[C - 1])
+        return;
+    // the LFE channel gets the bass share of the total signal, in the phase
+    // of Lt+Rt
+    for (unsigned int f = 1; f < bins; f++)
+    {
+        const cplx center = polar(sqrt(std::norm(lf[f]) + std::norm(rf[f])), std::arg(lf[f] + rf[f]));
+        bass[f] = bass_weight[f] * center;
+        short_audible[C - 1] = short_audible[C - 1] || bass[f] != cplx(0);
+    }
+    if (short_audible[C - 1])
+        back_transform(&short_out[(C - 1) * N]);
+}
+
+void DPL2FSDecoder::sync_short_decoder()
+{
+    DPL2FSDecoder &d = *short_decoder;
+    d.steering = steering;
+    d.steering_target = steering;
+    // the bass is redirected in the long block (see split_bass())
+    d.use_lfe = false;
+    d.active = active;
+    d.correlation_shortcut = correlation_shortcut;
+    d.sparse_level = sparse_level;
+    // the processing range is given in bins, which are N/n times as wide
+    // there; the band tables are only rebuilt on changes
+    const unsigned int n = d.N;
+    const unsigned int first = std::clamp((first_bin * n + N - 1) / N, 1u, n / 2);
+    const unsigned int last = std::clamp((last_bin - 1) * n / N + 1, first, n / 2);
+    if (d.first_bin != first || d.last_bin != last || d.band_resolution != band_resolution)
+    {
+        d.first_bin = first;
+        d.last_bin = last;
+        d.band_resolution = band_resolution;
+        d.bands_stale = true;
     }
 }
 
@@ -330,3 +1670,18 @@ void DPL2FSDecoder::transform_focus(double &x, double &y, const double focus)
     x = clamp(sin(ang) * len);
     y = clamp(cos(ang) * len);
 }
+
+// the parts of decode() that DecoderBatch runs stream by stream, for each
+// sample type
+template void DPL2FSDecoder::decode_pcm(const float *, void *, bool);
+template void DPL2FSDecoder::decode_pcm(const std::int16_t *, void *, bool);
+template void DPL2FSDecoder::decode_pcm(const pcm24 *, void *, bool);
+template void DPL2FSDecoder::decode_pcm(const std::int32_t *, void *, bool);
+template double DPL2FSDecoder::window_block(const float *, unsigned int, const float *);
+template double DPL2FSDecoder::window_block(const float *, unsigned int, const std::int16_t *);
+template double DPL2FSDecoder::window_block(const float *, unsigned int, const pcm24 *);
+template double DPL2FSDecoder::window_block(const float *, unsigned int, const std::int32_t *);
+template void DPL2FSDecoder::keep_history(const float *);
+template void DPL2FSDecoder::keep_history(const std::int16_t *);
+template void DPL2FSDecoder::keep_history(const pcm24 *);
+template void DPL2FSDecoder::keep_history(const std::int32_t *);
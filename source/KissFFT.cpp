@@ -36,11 +36,11 @@ ARISING IN ANY WAY OUT OF
 THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include "../include/FreeSurround/Denormals.h"
 #include "../include/FreeSurround/_KissFFTGuts.h"
 
-#include <numeric>
-#include <random>
-#include <vector>
+#include <algorithm>
+#include <climits>
 
 /* The guts header contains all the multiplication and addition macros that are
  defined for
@@ -144,7 +144,7 @@ static void kf_bfly3(kiss_fft_cpx *Fout, const size_t fstride, const kiss_fft_cf
         Fout[m].r = Fout->r - half_of(scratch[3].r);
         Fout[m].i = Fout->i - half_of(scratch[3].i);
 
-        c_mulbyscalar(scratch[0], i);
+        scratch[0] = c_mulbyscalar(scratch[0], i);
 
         *Fout = c_add(*Fout, scratch[3]);
 
@@ -245,11 +245,10 @@ static void kf_bfly_generic(kiss_fft_cpx *Fout, const size_t fstride, const kiss
             Fout[j] = scratch[0];
             for (int q = 1; q < p; ++q)
             {
-                kiss_fft_cpx t;
                 twidx += static_cast<int>(fstride) * j;
                 if (twidx >= Norig)
                     twidx -= Norig;
-                c_mul( scratch[q], twiddles[twidx]);
+                const kiss_fft_cpx t = c_mul(scratch[q], twiddles[twidx]);
                 Fout[j] = c_add(Fout[j], t);
             }
             j += m;
@@ -348,76 +347,47 @@ static void kf_work(kiss_fft_cpx *Fout, const kiss_fft_cpx *f, const size_t fstr
 }
 
 /**
- * @brief Implements Pollard's Rho algorithm to find a non-trivial factor of n.
+ * @brief Factors n into the radices of the butterflies, in the order they are
+ * applied.
  *
- * This function uses Pollard's Rho algorithm, a probabilistic integer factorization method.
- * The algorithm generates a sequence of numbers based on a quadratic recurrence and uses the
- * "tortoise and hare" technique to detect cycles. If a cycle is detected, the GCD of the
- * difference between two sequence values and n is computed, which yields a factor of n.
+ * Radix 4 is taken first, then 2, 3 and 5, which have specialized butterflies,
+ * and then increasing odd factors, which go through the generic one. Each
+ * factor is stored in facbuf together with the quotient that remains after
+ * dividing n by it.
  *
- * If n is even, the function immediately returns 2. Otherwise, the algorithm iterates
- * until it finds a non-trivial factor or determines that no factor exists.
- *
- * @param n The integer to factor. The function will return a non-trivial factor of n.
- *
- * @return A non-trivial factor of n if found, otherwise 0 if no factor is found.
- */
-int pollards_rho(const int n)
-{
-    if (n % 2 == 0)
-        return 2;
-
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution dist(1, n - 1);
-
-    int64_t x = dist(gen);
-    int64_t y = x;
-    const int64_t c = dist(gen);
-    int64_t d = 1;
-
-    while (d == 1)
-    {
-        x = (x * x + c) % n;
-        y = (y * y + c) % n;
-        y = (y * y + c) % n;
-        d = std::gcd(std::llabs(x - y), static_cast<int64_t>(n));
-    }
-
-    return d == n ? 0 : static_cast<int>(d);
-}
-
-/**
- * @brief Factorizes a number using Pollard's Rho algorithm.
- *
- * This function attempts to factor the given number `n` by repeatedly calling
- * the Pollard's Rho algorithm. It continuously divides `n` by each found factor and
- * stores the factors in the provided `facbuf` array. This method returns the prime
- * factors of `n` and updates the array with factor pairs: each factor and the quotient
- * of `n` after dividing by the factor.
- *
- * The factorization process continues until all factors of `n` are found, or until
- * Pollard's Rho fails to find further factors.
- *
- * @param n The integer to factor. It will be reduced during the process.
- * @param facbuf A pointer to an array where the factors will be stored. The factors are
- *               stored as pairs: each factor and the quotient of n after dividing by the factor.
+ * @param n The integer to factor.
+ * @param facbuf A pointer to an array where the factors will be stored, as pairs
+ *               of each factor and the remaining quotient.
  */
 void kf_factor(int n, int *facbuf)
 {
-    while (n > 1)
+    int p = 4;
+    const double floor_sqrt = floor(sqrt(static_cast<double>(n)));
+    do
     {
-        const int factor = pollards_rho(n);
-        if (factor == 0)
-            break;
-
-        while (n % factor == 0)
+        while (n % p)
         {
-            n /= factor;
-            *facbuf++ = factor;
-            *facbuf++ = n;
+            switch (p)
+            {
+            case 4:
+                p = 2;
+                break;
+            case 2:
+                p = 3;
+                break;
+            default:
+                p += 2;
+                break;
+            }
+            // no factor up to sqrt(n) left: n itself is prime
+            if (p > floor_sqrt)
+                p = n;
         }
+        n /= p;
+        *facbuf++ = p;
+        *facbuf++ = n;
     }
+    while (n > 1);
 }
 
 /*
@@ -464,6 +434,8 @@ kiss_fft_cfg kiss_fft_alloc(const int nfft, const int inverse_fft, void *mem, si
 
 void kiss_fft_stride(kiss_fft_cfg cfg, const kiss_fft_cpx *fin, kiss_fft_cpx *fout, int fin_stride)
 {
+    /* keep denormals out of the butterflies */
+    const DenormalScope ftz;
     if (fin != fout)
     {
         kf_work(fout, fin, 1, fin_stride, cfg->factors.data(), cfg);
@@ -482,6 +454,42 @@ void kiss_fft(const kiss_fft_cfg cfg, const kiss_fft_cpx *fin, kiss_fft_cpx *fou
     kiss_fft_stride(cfg, fin, fout, 1);
 }
 
+// number of Hamming numbers (products of powers of 2, 3 and 5) up to INT_MAX
+constexpr std::size_t count_hamming_numbers()
+{
+    std::size_t count = 0;
+    for (long long a = 1; a <= INT_MAX; a *= 2)
+        for (long long b = a; b <= INT_MAX; b *= 3)
+            for (long long c = b; c <= INT_MAX; c *= 5)
+                count++;
+    return count;
+}
+
+// all Hamming numbers up to INT_MAX in ascending order, generated at compile
+// time by merging the multiples of 2, 3 and 5 of the ones found so far
+constexpr auto hamming_numbers = []
+{
+    std::array<int, count_hamming_numbers()> numbers{1};
+    std::size_t i2 = 0;
+    std::size_t i3 = 0;
+    std::size_t i5 = 0;
+    for (std::size_t k = 1; k < numbers.size(); k++)
+    {
+        const long long next2 = 2LL * numbers[i2];
+        const long long next3 = 3LL * numbers[i3];
+        const long long next5 = 5LL * numbers[i5];
+        const long long next = std::min({next2, next3, next5});
+        numbers[k] = static_cast<int>(next);
+        if (next == next2)
+            i2++;
+        if (next == next3)
+            i3++;
+        if (next == next5)
+            i5++;
+    }
+    return numbers;
+}();
+
 /**
  * Finds the next largest integer that can be expressed as a product of
  * the prime factors 2, 3, and 5. This ensures the number is factorable
@@ -493,36 +501,8 @@ void kiss_fft(const kiss_fft_cfg cfg, const kiss_fft_cpx *fin, kiss_fft_cpx *fou
  */
 int kiss_fft_next_fast_size(const int n)
 {
-    std::vector hammingNumbers = {1}; // Start with 1 as the smallest Hamming number
-    int i2 = 0; // Pointers for multiples of 2
-    int i3 = 0; // Pointers for multiples of 3
-    int i5 = 0; // Pointers for multiples of 5
-
-    while (true)
-    {
-        // Generate the next candidates by multiplying with 2, 3, and 5
-        int next2 = hammingNumbers[i2] * 2;
-        int next3 = hammingNumbers[i3] * 3;
-        int next5 = hammingNumbers[i5] * 5;
-
-        // Find the smallest candidate
-        int nextHamming = std::ranges::min({next2, next3, next5});
-
-        // If the candidate is >= n, return it
-        if (nextHamming >= n)
-        {
-            return nextHamming;
-        }
-
-        // Add the smallest candidate to the list
-        hammingNumbers.push_back(nextHamming);
-
-        // Increment the respective pointer(s)
-        if (nextHamming == next2)
-            i2++;
-        if (nextHamming == next3)
-            i3++;
-        if (nextHamming == next5)
-            i5++;
-    }
+    // the smallest Hamming number above 1 that is at least n; larger sizes
+    // have no fast size within the int range and are returned as they are
+    const auto next = std::lower_bound(hamming_numbers.begin() + 1, hamming_numbers.end(), n);
+    return next == hamming_numbers.end() ? n : *next;
 }
@@ -40,6 +40,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iostream>
 #include <ostream>
 
+#include "../include/FreeSurround/Denormals.h"
 #include "../include/FreeSurround/KissFFTR.h"
 #include "../include/FreeSurround/_KissFFTGuts.h"
 
@@ -101,6 +102,7 @@ void kiss_fftr(kiss_fftr_cfg cfg, const kiss_fft_scalar *timedata, kiss_fft_cpx
 {
     /* input buffer timedata is stored row-wise */
     kiss_fft_cpx tdc;
+    const DenormalScope ftz;
 
     if (cfg->substate->inverse)
     {
@@ -159,6 +161,7 @@ void kiss_fftr(kiss_fftr_cfg cfg, const kiss_fft_scalar *timedata, kiss_fft_cpx
 void kiss_fftri(kiss_fftr_cfg cfg, const kiss_fft_cpx *freqdata, kiss_fft_scalar *timedata)
 {
     /* input buffer timedata is stored row-wise */
+    const DenormalScope ftz;
 
     if (cfg->substate->inverse == 0)
     {
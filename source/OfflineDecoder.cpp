@@ -0,0 +1,72 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/OfflineDecoder.h"
+
+#include <algorithm>
+
+void OfflineDecoder::Init(const channel_setup chsetup, const unsigned int blocksize, const unsigned int sample_rate,
+                          setup_function setup, const unsigned int threads)
+{
+    config = {chsetup, blocksize, sample_rate};
+    this->setup = std::move(setup);
+    prototype = DPL2FSDecoder();
+    make_decoder(prototype);
+    config = prototype.config();
+    pool = config.blocksize ? std::make_unique<TaskPool>(threads) : nullptr;
+}
+
+void OfflineDecoder::set_min_segment(const unsigned int blocks) { min_segment = std::max(blocks, 1u); }
+
+bool OfflineDecoder::decode(const float *input, const std::size_t blocks, float *output)
+{
+    if (!pool)
+        return false;
+    const std::size_t count = segments(blocks);
+    const std::size_t in_size = 2 * static_cast<std::size_t>(config.blocksize);
+    const std::size_t out_size = static_cast<std::size_t>(config.blocksize) * prototype.layout().channels;
+    pool->run(static_cast<unsigned int>(count),
+              [&](const unsigned int s)
+              {
+                  const std::size_t first = blocks * s / count;
+                  const std::size_t last = blocks * (s + 1) / count;
+                  DPL2FSDecoder decoder;
+                  make_decoder(decoder);
+                  // the output of the warm-up is dropped; the segment's own
+                  // blocks then decode as they would after all blocks before
+                  for (std::size_t b = first - std::min(first, warmup_blocks); b < first; b++)
+                      decoder.decode(input + b * in_size);
+                  for (std::size_t b = first; b < last; b++)
+                      std::copy_n(decoder.decode(input + b * in_size), out_size, output + b * out_size);
+              });
+    return true;
+}
+
+spectral_layout OfflineDecoder::layout() const { return config.blocksize ? prototype.layout() : spectral_layout{}; }
+
+std::size_t OfflineDecoder::segments(const std::size_t blocks) const
+{
+    if (!pool || prototype.sliding || prototype.glide_blocks > 0)
+        return 1;
+    return std::clamp<std::size_t>(blocks / min_segment, 1, pool->threads());
+}
+
+void OfflineDecoder::make_decoder(DPL2FSDecoder &decoder) const
+{
+    decoder.Init(config.setup, config.blocksize, config.sample_rate);
+    if (setup && decoder.config().blocksize)
+        setup(decoder);
+}
@@ -0,0 +1,160 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/SlidingDFT.h"
+
+#include <algorithm>
+
+// number of blocks after which the running sums are recomputed
+constexpr unsigned int refresh_blocks = 16;
+
+void SlidingDFT::init(const unsigned int blocksize, const std::vector<piece> &window)
+{
+    N = blocksize;
+    pieces = window;
+    twiddle.resize(N);
+    for (unsigned int k = 0; k < N; k++)
+        twiddle[k] = std::polar(1.0, -2 * pi * k / N);
+    rotor.resize(pieces.size());
+    for (unsigned int p = 0; p < pieces.size(); p++)
+    {
+        rotor[p].resize(pieces[p].period);
+        for (unsigned int k = 0; k < pieces[p].period; k++)
+            rotor[p][k] = std::polar(1.0, 2 * pi * k / pieces[p].period);
+    }
+    sums.assign(2 * pieces.size(), std::vector<cplx>(N / 2 + 1));
+    ring.resize(N);
+    std::size_t size = 0;
+    kiss_fftr_alloc(static_cast<int>(N), 0, nullptr, &size);
+    if (memory.size() < size)
+        memory.resize(size);
+    size = memory.size();
+    forward = kiss_fftr_alloc(static_cast<int>(N), 0, memory.data(), &size);
+    modulated.resize(N);
+    cos_part.resize(N / 2 + 1);
+    sin_part.resize(N / 2 + 1);
+    reset();
+}
+
+void SlidingDFT::reset()
+{
+    std::ranges::fill(ring, 0.0);
+    for (std::vector<cplx> &s : sums)
+        std::ranges::fill(s, cplx(0));
+    head = 0;
+    position = 0;
+    stale = 0;
+}
+
+void SlidingDFT::advance(const double *input, const unsigned int stride, const unsigned int hop, cplx *spectrum)
+{
+    // the sample at absolute position m, from the block or from the new hop
+    const auto sample = [&](const unsigned long long m)
+    {
+        const auto k = static_cast<unsigned int>(m - position);
+        return k < N ? ring[(head + k) % N] : input[(k - N) * stride];
+    };
+    // each piece moves from [first, last) by hop samples: take out those that
+    // leave it and add those that enter it
+    for (unsigned int p = 0; p < pieces.size(); p++)
+    {
+        const unsigned long long first = position + pieces[p].begin;
+        const unsigned long long last = position + pieces[p].end;
+        for (unsigned long long m = first; m < std::min(first + hop, last); m++)
+            accumulate(p, m, -sample(m));
+        for (unsigned long long m = std::max(last, first + hop); m < last + hop; m++)
+            accumulate(p, m, sample(m));
+    }
+    for (unsigned int k = 0; k < hop; k++)
+        ring[(head + k) % N] = input[k * stride];
+    head = (head + hop) % N;
+    position += hop;
+    stale += hop;
+    if (stale >= refresh_blocks * N)
+        refresh();
+    if (!spectrum)
+        return;
+
+    // sum up the pieces: with t the block position and theta the modulation
+    // phase at its start, amplitude*sin() contributes
+    // amplitude/(2i) * exp(2*pi*i*f*t/N) * (exp(-i*theta)*plus - exp(i*theta)*minus)
+    const auto shift = static_cast<unsigned int>(position % N);
+    std::fill_n(spectrum, N / 2 + 1, cplx(0));
+    for (unsigned int p = 0; p < pieces.size(); p++)
+    {
+        const cplx rot = rotor[p][(position + pieces[p].offset) % pieces[p].period];
+        const cplx scale = cplx(0, -0.5 * pieces[p].amplitude);
+        const cplx *plus = &sums[2 * p][0];
+        const cplx *minus = &sums[2 * p + 1][0];
+        unsigned int k = 0;
+        for (unsigned int f = 0; f <= N / 2; f++)
+        {
+            spectrum[f] += scale * std::conj(twiddle[k]) * (std::conj(rot) * plus[f] - rot * minus[f]);
+            k += shift;
+            if (k >= N)
+                k -= N;
+        }
+    }
+}
+
+void SlidingDFT::refresh()
+{
+    const auto shift = static_cast<unsigned int>(position % N);
+    for (unsigned int p = 0; p < pieces.size(); p++)
+    {
+        // transform the block samples of the piece times the cosine and the
+        // sine of the modulation
+        const piece &w = pieces[p];
+        std::ranges::fill(modulated, 0.0);
+        for (unsigned int n = w.begin; n < w.end; n++)
+            modulated[n] = ring[(head + n) % N] * rotor[p][(position + n) % w.period].real();
+        kiss_fftr(forward, &modulated[0], std::bit_cast<kiss_fft_cpx *>(&cos_part[0]));
+        for (unsigned int n = w.begin; n < w.end; n++)
+            modulated[n] = ring[(head + n) % N] * rotor[p][(position + n) % w.period].imag();
+        kiss_fftr(forward, &modulated[0], std::bit_cast<kiss_fft_cpx *>(&sin_part[0]));
+        // and move them from block to absolute positions
+        unsigned int k = 0;
+        for (unsigned int f = 0; f <= N / 2; f++)
+        {
+            const cplx i_sin = cplx(0, 1) * sin_part[f];
+            sums[2 * p][f] = twiddle[k] * (cos_part[f] + i_sin);
+            sums[2 * p + 1][f] = twiddle[k] * (cos_part[f] - i_sin);
+            k += shift;
+            if (k >= N)
+                k -= N;
+        }
+    }
+    stale = 0;
+}
+
+void SlidingDFT::accumulate(const unsigned int p, const unsigned long long m, const double x)
+{
+    if (x == 0)
+        return;
+    const cplx z = x * rotor[p][m % pieces[p].period];
+    const auto step = static_cast<unsigned int>(m % N);
+    cplx *plus = &sums[2 * p][0];
+    cplx *minus = &sums[2 * p + 1][0];
+    unsigned int k = 0;
+    for (unsigned int f = 0; f <= N / 2; f++)
+    {
+        plus[f] += z * twiddle[k];
+        minus[f] += std::conj(z) * twiddle[k];
+        k += step;
+        if (k >= N)
+            k -= N;
+    }
+}
@@ -0,0 +1,242 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/StreamScheduler.h"
+
+#include <algorithm>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+StreamScheduler::StreamScheduler(const unsigned int max_streams, const unsigned int queue_depth,
+                                 unsigned int threads, const bool pin_threads) :
+    max_streams(max_streams), queue_depth(std::max(queue_depth, 1u)),
+    streams(std::make_unique<stream[]>(max_streams))
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    workers.reserve(threads);
+    for (unsigned int w = 0; w < threads; w++)
+        workers.push_back(std::make_unique<worker>());
+    // the workers look into each other's queues, so they start once all exist
+    for (unsigned int w = 0; w < threads; w++)
+        workers[w]->thread = std::thread(
+            [this, w, pin_threads]
+            {
+                if (pin_threads)
+                    pin_thread(w);
+                run(w);
+            });
+}
+
+// blocks still queued are dropped
+StreamScheduler::~StreamScheduler()
+{
+    stopping = true;
+    for (const std::unique_ptr<worker> &w : workers)
+    {
+        {
+            const std::scoped_lock guard(w->lock);
+        }
+        w->wake.notify_all();
+    }
+    for (const std::unique_ptr<worker> &w : workers)
+        w->thread.join();
+}
+
+unsigned int StreamScheduler::add_stream(DPL2FSDecoder &&decoder, sink output, const std::chrono::microseconds budget)
+{
+    const unsigned int s = stream_count.load(std::memory_order_relaxed);
+    const decoder_config config = decoder.config();
+    if (s == max_streams || config.blocksize == 0)
+        return max_streams;
+    stream &t = streams[s];
+    t.frames = config.blocksize;
+    t.decoder = std::move(decoder);
+    t.output = std::move(output);
+    if (budget.count() > 0)
+        t.budget = budget;
+    else
+        t.budget = std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(t.frames) / config.sample_rate));
+    // homes go round the workers, so that each holds the same number of streams
+    t.home = next_home;
+    next_home = (next_home + 1) % static_cast<unsigned int>(workers.size());
+    t.slots.assign(static_cast<std::size_t>(queue_depth) * 2 * t.frames, 0);
+    t.deadline.assign(queue_depth, {});
+    stream_count.store(s + 1, std::memory_order_release);
+    return s;
+}
+
+bool StreamScheduler::submit(const unsigned int s, const float *input)
+{
+    if (s >= stream_count.load(std::memory_order_acquire))
+        return false;
+    stream &t = streams[s];
+    {
+        const std::scoped_lock guard(t.lock);
+        if (t.count == queue_depth)
+        {
+            t.rejected++;
+            return false;
+        }
+        const unsigned int slot = (t.head + t.count) % queue_depth;
+        std::copy_n(input, 2 * t.frames, &t.slots[static_cast<std::size_t>(slot) * 2 * t.frames]);
+        t.deadline[slot] = clock::now() + t.budget;
+        t.count++;
+        if (t.scheduled)
+            return true;
+        t.scheduled = true;
+    }
+    schedule(s);
+    return true;
+}
+
+stream_statistics StreamScheduler::statistics(const unsigned int s) const
+{
+    if (s >= stream_count.load(std::memory_order_acquire))
+        return {};
+    const stream &t = streams[s];
+    const std::scoped_lock guard(t.lock);
+    return {t.count, t.decoded, t.deadline_misses, t.rejected, t.stolen};
+}
+
+unsigned int StreamScheduler::threads() const { return static_cast<unsigned int>(workers.size()); }
+
+void StreamScheduler::set_steal_threshold(const unsigned int v) { steal_threshold = std::max(v, 1u); }
+
+void StreamScheduler::set_steal_interval(const std::chrono::microseconds v) { steal_interval_us = v.count(); }
+
+void StreamScheduler::run(const unsigned int w)
+{
+    worker &self = *workers[w];
+    while (!stopping)
+    {
+        unsigned int s;
+        bool stolen;
+        if (take(w, s, stolen))
+        {
+            decode_block(s, stolen);
+            continue;
+        }
+        // sleep until there is work of its own, looking for work to steal
+        // every steal interval
+        std::unique_lock guard(self.lock);
+        self.wake.wait_for(guard, std::chrono::microseconds(steal_interval_us.load(std::memory_order_relaxed)),
+                           [&] { return stopping || !self.ready.empty(); });
+    }
+}
+
+bool StreamScheduler::take(const unsigned int w, unsigned int &s, bool &stolen)
+{
+    {
+        worker &self = *workers[w];
+        const std::scoped_lock guard(self.lock);
+        if (!self.ready.empty())
+        {
+            s = self.ready.front();
+            self.ready.pop_front();
+            stolen = false;
+            return true;
+        }
+    }
+    const unsigned int threshold = steal_threshold.load(std::memory_order_relaxed);
+    unsigned int victim = w;
+    std::size_t longest = 0;
+    for (unsigned int v = 0; v < workers.size(); v++)
+    {
+        if (v == w)
+            continue;
+        const std::scoped_lock guard(workers[v]->lock);
+        const std::size_t waiting = workers[v]->ready.size();
+        if (waiting >= threshold && waiting > longest)
+        {
+            victim = v;
+            longest = waiting;
+        }
+    }
+    if (victim == w)
+        return false;
+    // the back of the queue has waited the least, so it is taken
+    worker &other = *workers[victim];
+    const std::scoped_lock guard(other.lock);
+    if (other.ready.size() < threshold)
+        return false;
+    s = other.ready.back();
+    other.ready.pop_back();
+    stolen = true;
+    return true;
+}
+
+void StreamScheduler::schedule(const unsigned int s)
+{
+    worker &w = *workers[streams[s].home];
+    {
+        const std::scoped_lock guard(w.lock);
+        w.ready.push_back(s);
+    }
+    w.wake.notify_one();
+}
+
+// the queue stays locked only to find the block and to retire it, so that
+// producers can go on submitting while it is decoded
+void StreamScheduler::decode_block(const unsigned int s, const bool stolen)
+{
+    stream &t = streams[s];
+    const float *input;
+    clock::time_point due;
+    {
+        const std::scoped_lock guard(t.lock);
+        input = &t.slots[static_cast<std::size_t>(t.head) * 2 * t.frames];
+        due = t.deadline[t.head];
+    }
+    t.output(s, t.decoder.decode(input));
+    const bool late = clock::now() > due;
+    bool more;
+    {
+        const std::scoped_lock guard(t.lock);
+        t.head = (t.head + 1) % queue_depth;
+        t.count--;
+        t.decoded++;
+        t.deadline_misses += late;
+        t.stolen += stolen;
+        more = t.count > 0;
+        t.scheduled = more;
+    }
+    // one block at a time, taking turns with the other streams of its home
+    if (more)
+        schedule(s);
+}
+
+void StreamScheduler::pin_thread(const unsigned int core)
+{
+    const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << core % cores % (8 * sizeof(DWORD_PTR)));
+#else
+    (void)core;
+    (void)cores;
+#endif
+}
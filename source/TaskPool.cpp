@@ -0,0 +1,83 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "../include/FreeSurround/TaskPool.h"
+
+#include <algorithm>
+
+TaskPool::TaskPool(unsigned int threads)
+{
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    helpers.reserve(threads - 1);
+    for (unsigned int t = 1; t < threads; t++)
+        helpers.emplace_back([this] { work(); });
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        const std::scoped_lock guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &t : helpers)
+        t.join();
+}
+
+void TaskPool::run(const unsigned int n, const task &f)
+{
+    std::unique_lock guard(lock);
+    current = &f;
+    count = n;
+    next = 0;
+    done = 0;
+    wake.notify_all();
+    // the calling thread takes tasks as well, and then waits for those that
+    // are still running elsewhere
+    while (next < count)
+    {
+        const unsigned int i = next++;
+        guard.unlock();
+        f(i);
+        guard.lock();
+        done++;
+    }
+    finished.wait(guard, [&] { return done == count; });
+    current = nullptr;
+    count = 0;
+    next = 0;
+}
+
+unsigned int TaskPool::threads() const { return static_cast<unsigned int>(helpers.size()) + 1; }
+
+void TaskPool::work()
+{
+    std::unique_lock guard(lock);
+    for (;;)
+    {
+        wake.wait(guard, [&] { return stopping || next < count; });
+        if (stopping)
+            return;
+        const unsigned int i = next++;
+        const task &f = *current;
+        guard.unlock();
+        f(i);
+        guard.lock();
+        if (++done == count)
+            finished.notify_one();
+    }
+}